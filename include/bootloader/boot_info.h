@@ -40,6 +40,9 @@ typedef EFI_MEMORY_DESCRIPTOR efi_mem_desc_t;
 #define EFI_PAL_CODE 13
 #define EFI_PERSISTENT_MEMORY 14
 
+// OS defined type, pages backing ram disk file data that the kernel keeps after boot.
+#define EFI_RAM_DISK_DATA 0x80000000
+
 #define EFI_IS_MEMORY_AVAIL(type) \
     ((type == EFI_CONVENTIONAL_MEMORY) || (type == EFI_PERSISTENT_MEMORY) || (type == EFI_LOADER_CODE) || \
         (type == EFI_BOOT_SERVICES_CODE) || (type == EFI_BOOT_SERVICES_DATA))
@@ -33,6 +33,10 @@ typedef struct
 #define RECT_HEIGHT(rect) ((rect)->bottom - (rect)->top)
 #define RECT_AREA(rect) (RECT_WIDTH(rect) * RECT_HEIGHT(rect))
 
+#define RECT_EQUAL(rect, other) \
+    ((rect)->left == (other)->left && (rect)->top == (other)->top && (rect)->right == (other)->right && \
+        (rect)->bottom == (other)->bottom)
+
 #define RECT_CONTAINS(rect, other) \
     ((other)->left >= (rect)->left && (other)->right <= (rect)->right && (other)->top >= (rect)->top && \
         (other)->bottom <= (rect)->bottom)
@@ -52,6 +56,13 @@ typedef struct
         (rect)->bottom = CLAMP((rect)->bottom, (parent)->top, (parent)->bottom); \
     })
 
+#define RECT_UNION(rect, other) \
+    (rect_t) \
+    { \
+        MIN((rect)->left, (other)->left), MIN((rect)->top, (other)->top), MAX((rect)->right, (other)->right), \
+            MAX((rect)->bottom, (other)->bottom), \
+    }
+
 #define RECT_SHRINK(rect, margin) \
     ({ \
         (rect)->left += margin; \
@@ -88,11 +99,13 @@ typedef struct
             } \
             if ((other)->left > (rect)->left) \
             { \
-                res.rects[res.count++] = (rect_t){(rect)->left, (other)->top, (other)->left, (other)->bottom}; \
+                res.rects[res.count++] = (rect_t){(rect)->left, MAX((rect)->top, (other)->top), (other)->left, \
+                    MIN((rect)->bottom, (other)->bottom)}; \
             } \
             if ((other)->right < (rect)->right) \
             { \
-                res.rects[res.count++] = (rect_t){(other)->right, (other)->top, (rect)->right, (other)->bottom}; \
+                res.rects[res.count++] = (rect_t){(other)->right, MAX((rect)->top, (other)->top), (rect)->right, \
+                    MIN((rect)->bottom, (other)->bottom)}; \
             } \
         } \
         *(result) = res; \
@@ -0,0 +1,25 @@
+#ifndef _AUX_REGION_T_H
+#define _AUX_REGION_T_H 1
+
+#include <stdint.h>
+
+#include "rect_t.h"
+
+#define REGION_MAX_RECT 8
+
+// A set of disjoint rects, see region_add() for how rects are merged once the set is full.
+typedef struct region
+{
+    rect_t rects[REGION_MAX_RECT];
+    uint8_t count;
+} region_t;
+
+#define REGION_INIT() \
+    (region_t) \
+    { \
+        .count = 0, \
+    }
+
+#define REGION_EMPTY(region) ((region)->count == 0)
+
+#endif
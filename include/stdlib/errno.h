@@ -37,6 +37,7 @@ int* _ErrnoFunc(void);
 #define EISDIR 19  // Is a directory
 #define ENORES 20  // No such resource
 #define EBUSY 21   // Busy
+#define ENOSPC 22  // No space left
 
 // NOTE: Values retrievd from linux
 /*
@@ -74,6 +74,17 @@ typedef struct ioctl_dwm_size
     uint32_t outHeight;
 } ioctl_dwm_size_t;
 
+// Read from sys:/dwm_stats, times are measured from the start of a frame.
+typedef struct dwm_stats
+{
+    uint64_t frames;
+    uint64_t redraws; // Amount of redraw requests, requests made within the same frame interval share a frame.
+    nsec_t lastFrameTime;
+    nsec_t maxFrameTime;
+    nsec_t totalFrameTime;
+    nsec_t lastFrameInterval;
+} dwm_stats_t;
+
 #define IOCTL_DWM_CREATE 0
 #define IOCTL_DWM_SIZE 1
 
@@ -83,9 +94,19 @@ typedef struct ioctl_window_receive
     msg_t outMsg;
 } ioctl_window_receive_t;
 
+// Variable size, the amount of messages to receive is given by the size passed to ioctl(). Blocks until at least one
+// message is available or the timeout is reached.
+typedef struct ioctl_window_receive_many
+{
+    nsec_t timeout;
+    uint64_t outAmount;
+    msg_t outMsgs[];
+} ioctl_window_receive_many_t;
+
 typedef struct ioctl_window_send
 {
     msg_t msg;
+    uint64_t size; // Amount of bytes used in msg.data, at most MSG_MAX_DATA.
 } ioctl_window_send_t;
 
 typedef struct ioctl_window_move
@@ -95,8 +116,26 @@ typedef struct ioctl_window_move
     uint32_t height;
 } ioctl_window_move_t;
 
+// Counters of the message queue of a window. Consecutive mouse motion is coalesced into one message, messages are only
+// dropped if the queue is at its maximum size.
+typedef struct ioctl_window_stats
+{
+    uint64_t outPushed;
+    uint64_t outCoalesced;
+    uint64_t outDropped;
+    uint64_t outPending;
+    uint64_t outMaxPending;
+    uint64_t outCapacity; // In bytes.
+} ioctl_window_stats_t;
+
+// The window surface can be mapped with mmap() on the window fd, after drawing into it call flush() with a NULL buffer
+// to report the damaged rect. Resizing the window keeps the overlapping contents but may move the surface, it must then
+// be mapped again.
+
 #define IOCTL_WINDOW_RECEIVE 0
 #define IOCTL_WINDOW_SEND 1
 #define IOCTL_WINDOW_MOVE 2
+#define IOCTL_WINDOW_STATS 3
+#define IOCTL_WINDOW_RECEIVE_MANY 4
 
 #endif
@@ -12,12 +12,17 @@ extern "C"
 #include "_AUX/pixel_t.h"
 #include "_AUX/point_t.h"
 #include "_AUX/rect_t.h"
+#include "_AUX/region_t.h"
 
 #define PSF1_MAGIC 0x0436
 #define PSF2_MAGIC 0x864AB572
 #define PSF1_MODE_512 (1 << 0)
 
 #define FBMP_MAGIC 0x706D6266
+#define FBMP2_MAGIC 0x32706D66
+
+#define FBMP2_PREMULTIPLIED (1 << 0)
+#define FBMP2_RUN (1U << 31)
 
 typedef enum gfx_align
 {
@@ -26,6 +31,12 @@ typedef enum gfx_align
     GFX_MIN = 2,
 } gfx_align_t;
 
+typedef enum gfx_filter
+{
+    GFX_NEAREST = 0,
+    GFX_BILINEAR = 1, // Translucent images should be premultiplied first or transparent pixels bleed their color.
+} gfx_filter_t;
+
 typedef struct fbmp
 {
     uint32_t magic;
@@ -34,24 +45,117 @@ typedef struct fbmp
     pixel_t data[];
 } gfx_fbmp_t;
 
+// Version 2 of the format, both versions are loaded and drawn through gfx_fbmp_t which only shares the first three fields.
+// The image is split into square tiles each compressed with run length encoding. A tile is a sequence of packets, each a
+// uint32_t count followed by one pixel repeated count times if FBMP2_RUN is set in the count, otherwise by count pixels.
+typedef struct fbmp2
+{
+    uint32_t magic;
+    uint32_t width;
+    uint32_t height;
+    uint32_t flags;
+    uint32_t tileSize;
+    uint32_t tileAmount;
+    uint32_t offsets[]; // Byte offsets of the tiles from the start of the file, tileAmount + 1 entries.
+} gfx_fbmp2_t;
+
 typedef struct gfx_psf
 {
     uint32_t width;
     uint32_t height;
     uint32_t glyphSize;
     uint32_t glyphAmount;
-    uint8_t* glyphs;
+    const uint8_t* glyphs;
+    void* map;
+    uint64_t mapSize;
+    struct gfx_glyph_cache* cache;
 } gfx_psf_t;
 
+// Describes the pixels of a gfx_t, drawing functions do not update the flags so they are a promise made by whoever owns
+// the buffer. Opaque pixels are the same in both formats, so a premultiplied source may be blended onto an opaque buffer.
+typedef enum gfx_flags
+{
+    GFX_NONE = 0,
+    GFX_PREMULTIPLIED = 1 << 0, // Color channels are already multiplied by alpha.
+    GFX_OPAQUE = 1 << 1,        // Every pixel has full alpha, blending from the buffer is a plain copy.
+} gfx_flags_t;
+
 typedef struct gfx
 {
     pixel_t* buffer;
     uint32_t width;
     uint32_t height;
     uint32_t stride;
-    rect_t invalidRect;
+    gfx_flags_t flags;
+    region_t invalidRegion;
 } gfx_t;
 
+// Keeps a scaled copy of an image that is only redone when the image buffer, its size, the target size or the filter
+// changes. Must be zero initialized, an image changed in place must be followed by gfx_scaled_cleanup().
+typedef struct gfx_scaled
+{
+    gfx_t gfx;
+    const pixel_t* source;
+    uint32_t sourceWidth;
+    uint32_t sourceHeight;
+    gfx_filter_t filter;
+} gfx_scaled_t;
+
+#define GFX_CMD_LIST_MAX 32
+
+typedef enum gfx_cmd_type
+{
+    GFX_CMD_RECT = 0,
+    GFX_CMD_EDGE = 1,
+    GFX_CMD_TEXT = 2,
+    GFX_CMD_TRANSFER = 3,
+    GFX_CMD_TRANSFER_BLEND = 4,
+} gfx_cmd_type_t;
+
+// A recorded drawing operation, rect is the area it draws to.
+typedef struct gfx_cmd
+{
+    gfx_cmd_type_t type;
+    rect_t rect;
+    union {
+        struct
+        {
+            pixel_t pixel;
+        } fill;
+        struct
+        {
+            uint64_t width;
+            pixel_t foreground;
+            pixel_t background;
+        } edge;
+        struct
+        {
+            gfx_psf_t* psf;
+            const char* str;
+            uint64_t scale;
+            uint64_t amount;
+            uint64_t dots;
+            pixel_t foreground;
+            pixel_t background;
+        } text;
+        struct
+        {
+            const gfx_t* src;
+            point_t srcPoint;
+        } transfer;
+    };
+} gfx_cmd_t;
+
+// Operations recorded with the gfx_cmd_*() functions are drawn by gfx_cmd_list_flush() one band of rows at a time, each
+// band running every operation that overlaps it in recorded order, so overlapping operations share the rows while they
+// are still cached. Strings and source surfaces must stay valid until the flush, a full list is flushed early.
+typedef struct gfx_cmd_list
+{
+    gfx_t* gfx;
+    gfx_cmd_t cmds[GFX_CMD_LIST_MAX];
+    uint64_t amount;
+} gfx_cmd_list_t;
+
 #define RECT_INIT_GFX(gfx) \
     (rect_t){ \
         0, \
@@ -74,10 +178,10 @@ void gfx_psf_cleanup(gfx_psf_t* psf);
 
 void gfx_fbmp(gfx_t* gfx, const gfx_fbmp_t* fbmp, const point_t* point);
 
-void gfx_psf_char(gfx_t* gfx, const gfx_psf_t* psf, const point_t* point, uint64_t height, char chr, pixel_t foreground,
+void gfx_psf_char(gfx_t* gfx, gfx_psf_t* psf, const point_t* point, uint64_t height, char chr, pixel_t foreground,
     pixel_t background);
 
-void gfx_psf(gfx_t* gfx, const gfx_psf_t* psf, const rect_t* rect, gfx_align_t xAlign, gfx_align_t yAlign, uint64_t height,
+void gfx_psf(gfx_t* gfx, gfx_psf_t* psf, const rect_t* rect, gfx_align_t xAlign, gfx_align_t yAlign, uint64_t height,
     const char* str, pixel_t foreground, pixel_t background);
 
 void gfx_rect(gfx_t* gfx, const rect_t* rect, pixel_t pixel);
@@ -94,8 +198,39 @@ void gfx_transfer_blend(gfx_t* dest, const gfx_t* src, const rect_t* destRect, c
 
 void gfx_swap(gfx_t* dest, const gfx_t* src, const rect_t* rect);
 
+void gfx_scale(gfx_t* dest, const gfx_t* src, const rect_t* destRect, const rect_t* srcRect, gfx_filter_t filter);
+
+const gfx_t* gfx_scaled_get(gfx_scaled_t* scaled, const gfx_t* src, uint32_t width, uint32_t height, gfx_filter_t filter);
+
+void gfx_scaled_cleanup(gfx_scaled_t* scaled);
+
+void gfx_premultiply(gfx_t* gfx);
+
 void gfx_invalidate(gfx_t* gfx, const rect_t* rect);
 
+void gfx_cmd_list_init(gfx_cmd_list_t* list, gfx_t* gfx);
+
+void gfx_cmd_list_flush(gfx_cmd_list_t* list);
+
+void gfx_cmd_rect(gfx_cmd_list_t* list, const rect_t* rect, pixel_t pixel);
+
+void gfx_cmd_edge(gfx_cmd_list_t* list, const rect_t* rect, uint64_t width, pixel_t foreground, pixel_t background);
+
+void gfx_cmd_ridge(gfx_cmd_list_t* list, const rect_t* rect, uint64_t width, pixel_t foreground, pixel_t background);
+
+void gfx_cmd_rim(gfx_cmd_list_t* list, const rect_t* rect, uint64_t width, pixel_t pixel);
+
+void gfx_cmd_psf(gfx_cmd_list_t* list, gfx_psf_t* psf, const rect_t* rect, gfx_align_t xAlign, gfx_align_t yAlign,
+    uint64_t height, const char* str, pixel_t foreground, pixel_t background);
+
+void gfx_cmd_transfer(gfx_cmd_list_t* list, const gfx_t* src, const rect_t* destRect, const point_t* srcPoint);
+
+void gfx_cmd_transfer_blend(gfx_cmd_list_t* list, const gfx_t* src, const rect_t* destRect, const point_t* srcPoint);
+
+void region_add(region_t* region, const rect_t* rect);
+
+void region_bounds(const region_t* region, rect_t* rect);
+
 #if defined(__cplusplus)
 }
 #endif
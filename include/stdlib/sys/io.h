@@ -58,6 +58,14 @@ typedef struct dir
     stat_type_t type;
 } dir_entry_t;
 
+#define IOV_MAX 16
+
+typedef struct iovec
+{
+    void* base;
+    uint64_t length;
+} iovec_t;
+
 #ifndef __EMBED__
 
 fd_t open(const char* path);
@@ -68,6 +76,14 @@ uint64_t read(fd_t fd, void* buffer, uint64_t count);
 
 uint64_t write(fd_t fd, const void* buffer, uint64_t count);
 
+uint64_t readv(fd_t fd, const iovec_t* iov, uint64_t amount);
+
+uint64_t writev(fd_t fd, const iovec_t* iov, uint64_t amount);
+
+uint64_t pread(fd_t fd, void* buffer, uint64_t count, uint64_t offset);
+
+uint64_t pwrite(fd_t fd, const void* buffer, uint64_t count, uint64_t offset);
+
 uint64_t seek(fd_t fd, int64_t offset, seek_origin_t origin);
 
 uint64_t realpath(char* out, const char* path);
@@ -84,6 +100,12 @@ uint64_t flush(fd_t fd, const pixel_t* buffer, uint64_t size, const rect_t* rect
 
 uint64_t listdir(const char* path, dir_entry_t* entries, uint64_t amount);
 
+uint64_t create(const char* path);
+
+uint64_t unlink(const char* path);
+
+uint64_t truncate(fd_t fd, uint64_t length);
+
 uint64_t loaddir(dir_entry_t** out, const char* path);
 
 #endif
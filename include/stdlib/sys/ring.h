@@ -0,0 +1,96 @@
+#ifndef _SYS_RING_H
+#define _SYS_RING_H 1
+
+#include <stdint.h>
+#include <sys/io.h>
+#include <sys/proc.h>
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+#include "_AUX/ERR.h"
+#include "_AUX/errno_t.h"
+#include "_AUX/fd_t.h"
+
+// A submission/completion ring shared between a process and the kernel, opened from "sys:/ring" and mapped with mmap.
+// The process writes entries to the submission queue, the kernel consumes them on IOCTL_RING_ENTER and posts one
+// completion for each consumed submission. Head and tail are free running counters, use RING_*_INDEX to get a slot.
+
+#define RING_SQ_MAX 32
+#define RING_CQ_MAX 64
+
+#define RING_SQ_INDEX(counter) ((counter) % RING_SQ_MAX)
+#define RING_CQ_INDEX(counter) ((counter) % RING_CQ_MAX)
+
+typedef enum
+{
+    RING_OP_NOP = 0,
+    RING_OP_READ = 1,  // args: buffer, count
+    RING_OP_WRITE = 2, // args: buffer, count
+    RING_OP_SEEK = 3,  // args: offset, origin
+    RING_OP_IOCTL = 4, // args: request, argp, size
+    RING_OP_FLUSH = 5, // args: buffer, size, rect
+    RING_OP_CLOSE = 6,
+    RING_OP_PREAD = 7,  // args: buffer, count, offset
+    RING_OP_PWRITE = 8, // args: buffer, count, offset
+    RING_OP_MAX = 8
+} ring_op_t;
+
+typedef struct ring_sqe
+{
+    ring_op_t op;
+    fd_t fd;
+    uint64_t args[4];
+    uint64_t userData;
+} ring_sqe_t;
+
+typedef struct ring_cqe
+{
+    uint64_t userData;
+    uint64_t result;
+    errno_t error;
+} ring_cqe_t;
+
+typedef struct ring
+{
+    _Atomic(uint32_t) sqHead; // Written by the kernel
+    _Atomic(uint32_t) sqTail; // Written by the process
+    _Atomic(uint32_t) cqHead; // Written by the process
+    _Atomic(uint32_t) cqTail; // Written by the kernel
+    ring_sqe_t sq[RING_SQ_MAX];
+    ring_cqe_t cq[RING_CQ_MAX];
+} ring_t;
+
+_Static_assert(sizeof(ring_t) <= PAGE_SIZE, "ring_t does not fit in a page");
+
+typedef struct ioctl_ring_enter
+{
+    uint64_t amount; // Maximum amount of submissions to consume.
+    uint64_t outCompleted;
+} ioctl_ring_enter_t;
+
+#define IOCTL_RING_ENTER 0
+
+#ifndef __EMBED__
+
+fd_t ring_setup(ring_t** out);
+
+ring_sqe_t* ring_sqe_get(ring_t* ring);
+
+void ring_submit(ring_t* ring);
+
+uint64_t ring_enter(fd_t fd, uint64_t amount);
+
+ring_cqe_t* ring_cqe_peek(ring_t* ring);
+
+void ring_cqe_seen(ring_t* ring);
+
+#endif
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
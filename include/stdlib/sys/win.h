@@ -33,6 +33,14 @@ typedef enum win_flags
 
 typedef uint16_t widget_id_t;
 
+typedef uint64_t win_timer_id_t;
+
+typedef enum win_timer_flags
+{
+    WIN_TIMER_NONE = 0,
+    WIN_TIMER_REPEAT = (1 << 0)
+} win_timer_flags_t;
+
 typedef struct win_theme
 {
     uint8_t edgeWidth;
@@ -97,12 +105,18 @@ typedef struct lmsg_command
     widget_id_t id;
 } lmsg_command_t;
 
+typedef struct lmsg_timer
+{
+    win_timer_id_t id;
+} lmsg_timer_t;
+
 #define LMSG_BASE (1 << 14)
 #define LMSG_INIT (LMSG_BASE + 0)
 #define LMSG_FREE (LMSG_BASE + 1)
 #define LMSG_QUIT (LMSG_BASE + 2)
 #define LMSG_REDRAW (LMSG_BASE + 3)
 #define LMSG_COMMAND (LMSG_BASE + 4)
+#define LMSG_TIMER (LMSG_BASE + 5)
 
 // Widget messages
 typedef msg_mouse_t wmsg_mouse_t;
@@ -134,8 +148,11 @@ typedef win_text_prop_t wmsg_text_prop_t;
 win_t* win_new(const char* name, const rect_t* rect, dwm_type_t type, win_flags_t flags, win_proc_t procedure);
 uint64_t win_free(win_t* window);
 uint64_t win_poll(win_t** windows, uint64_t amount, nsec_t timeout);
+uint64_t win_timer_set(win_t* window, win_timer_id_t id, nsec_t timeout, win_timer_flags_t flags);
+uint64_t win_timer_cancel(win_t* window, win_timer_id_t id);
 uint64_t win_send(win_t* window, msg_type_t type, const void* data, uint64_t size);
 uint64_t win_receive(win_t* window, msg_t* msg, nsec_t timeout);
+uint64_t win_receive_batch(win_t* window, msg_t* msgs, uint64_t amount, nsec_t timeout);
 uint64_t win_dispatch(win_t* window, const msg_t* msg);
 uint64_t win_draw_begin(win_t* window, gfx_t* gfx);
 uint64_t win_draw_end(win_t* window, gfx_t* gfx);
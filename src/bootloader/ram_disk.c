@@ -16,8 +16,20 @@ static ram_file_t* ram_disk_load_file(EFI_FILE* volume, CHAR16* path)
     list_entry_init(&file->entry);
     char16_to_char(path, file->name);
     file->size = fs_get_size(fileHandle);
-    file->data = vm_alloc(file->size);
-    fs_read(fileHandle, file->size, file->data);
+    if (file->size != 0)
+    {
+        // Page aligned and of its own memory type so the kernel can adopt and map the pages instead of copying them.
+        uint64_t pageAmount = EFI_SIZE_TO_PAGES(file->size);
+        file->data = vm_alloc_higher_pages(pageAmount, EFI_RAM_DISK_DATA);
+        fs_read(fileHandle, file->size, file->data);
+
+        // The tail of the last page becomes visible to processes that map the file.
+        SetMem((uint8_t*)file->data + file->size, pageAmount * EFI_PAGE_SIZE - file->size, 0);
+    }
+    else
+    {
+        file->data = NULL;
+    }
 
     fs_close(fileHandle);
 
@@ -56,6 +56,23 @@ void* vm_alloc(uint64_t size)
     return (void*)((uint64_t)AllocatePool(size) + HIGHER_HALF_BASE);
 }
 
+void* vm_alloc_higher_pages(uint64_t pageAmount, uint32_t type)
+{
+    EFI_PHYSICAL_ADDRESS physAddr = 0;
+    EFI_STATUS status = uefi_call_wrapper(BS->AllocatePages, 4, AllocateAnyPages, type, pageAmount, &physAddr);
+    if (EFI_ERROR(status))
+    {
+        Print(L"ERROR: Unable to allocate pages!");
+
+        while (1)
+        {
+            asm volatile("hlt");
+        }
+    }
+
+    return (void*)(physAddr + HIGHER_HALF_BASE);
+}
+
 void vm_map_init(efi_mem_map_t* memoryMap)
 {
     mem_map_init(memoryMap);
@@ -12,4 +12,6 @@ void* vm_alloc_pages(void* virtAddr, uint64_t pageAmount, uint32_t type);
 
 void* vm_alloc(uint64_t size);
 
+void* vm_alloc_higher_pages(uint64_t pageAmount, uint32_t type);
+
 void vm_map_init(efi_mem_map_t* memoryMap);
@@ -5,4 +5,14 @@
 #define CONFIG_KERNEL_STACK (PAGE_SIZE)
 #define CONFIG_USER_STACK (PAGE_SIZE)
 #define CONFIG_MAX_FD 64
+#define CONFIG_DCACHE_BUCKETS 256
+#define CONFIG_DCACHE_BUCKET_MAX 8
+#define CONFIG_DWM_MAX_VISIBLE 64
+#define CONFIG_DWM_HZ 60
+#define CONFIG_DWM_TILE_HEIGHT 64
+#define CONFIG_DWM_MAX_OPS 256
+#define CONFIG_DWM_MOUSE_EVENTS 16
+#define CONFIG_TMPFS_MAX_PAGES (1 << 16)
+#define CONFIG_MSG_QUEUE_MIN 512
+#define CONFIG_MSG_QUEUE_MAX (PAGE_SIZE * 4)
 #define CONFIG_LOG_SERIAL true
@@ -0,0 +1,114 @@
+#include "dcache.h"
+
+#include "lock.h"
+#include "log.h"
+#include "vfs.h"
+
+#include <stdlib.h>
+
+static dcache_bucket_t buckets[CONFIG_DCACHE_BUCKETS];
+static lock_t lock;
+
+static uint64_t dcache_hash(const void* parent, const char* name, stat_type_t type)
+{
+    uint64_t hash = name_hash(name) ^ ((uint64_t)parent * 0x9E3779B97F4A7C15) ^ type;
+    return hash ^ (hash >> 32);
+}
+
+static dentry_t* dcache_find(dcache_bucket_t* bucket, uint64_t hash, const void* parent, const char* name,
+    stat_type_t type)
+{
+    dentry_t* dentry;
+    LIST_FOR_EACH(dentry, &bucket->entries)
+    {
+        if (dentry->hash == hash && dentry->parent == parent && dentry->type == type && name_compare(dentry->name, name))
+        {
+            return dentry;
+        }
+    }
+
+    return NULL;
+}
+
+void dcache_init(void)
+{
+    for (uint64_t i = 0; i < CONFIG_DCACHE_BUCKETS; i++)
+    {
+        list_init(&buckets[i].entries);
+        buckets[i].amount = 0;
+    }
+    lock_init(&lock);
+
+    log_print("dcache: init");
+}
+
+bool dcache_lookup(const void* parent, const char* name, stat_type_t type, void** node)
+{
+    uint64_t hash = dcache_hash(parent, name, type);
+    dcache_bucket_t* bucket = &buckets[hash % CONFIG_DCACHE_BUCKETS];
+    LOCK_GUARD(&lock);
+
+    dentry_t* dentry = dcache_find(bucket, hash, parent, name, type);
+    if (dentry == NULL)
+    {
+        return false;
+    }
+
+    // Keep buckets in most recently used order so eviction drops the least recently used entry.
+    list_remove(dentry);
+    list_append(&bucket->entries.head, dentry);
+
+    *node = dentry->node;
+    return true;
+}
+
+void dcache_insert(const void* parent, const char* name, stat_type_t type, void* node)
+{
+    uint64_t hash = dcache_hash(parent, name, type);
+    dcache_bucket_t* bucket = &buckets[hash % CONFIG_DCACHE_BUCKETS];
+    LOCK_GUARD(&lock);
+
+    dentry_t* dentry = dcache_find(bucket, hash, parent, name, type);
+    if (dentry != NULL)
+    {
+        list_remove(dentry);
+    }
+    else if (bucket->amount >= CONFIG_DCACHE_BUCKET_MAX)
+    {
+        dentry = (dentry_t*)bucket->entries.head.prev;
+        list_remove(dentry);
+    }
+    else
+    {
+        dentry = malloc(sizeof(dentry_t));
+        if (dentry == NULL)
+        {
+            return;
+        }
+        list_entry_init(&dentry->entry);
+        bucket->amount++;
+    }
+
+    dentry->hash = hash;
+    dentry->parent = parent;
+    dentry->type = type;
+    name_copy(dentry->name, name);
+    dentry->node = node;
+
+    list_append(&bucket->entries.head, dentry);
+}
+
+void dcache_invalidate(const void* parent, const char* name, stat_type_t type)
+{
+    uint64_t hash = dcache_hash(parent, name, type);
+    dcache_bucket_t* bucket = &buckets[hash % CONFIG_DCACHE_BUCKETS];
+    LOCK_GUARD(&lock);
+
+    dentry_t* dentry = dcache_find(bucket, hash, parent, name, type);
+    if (dentry != NULL)
+    {
+        list_remove(dentry);
+        bucket->amount--;
+        free(dentry);
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <sys/io.h>
+#include <sys/list.h>
+
+#include "defs.h"
+
+// Global lookup cache for filesystems, maps a (parent, name, type) tuple to the filesystems own node. A cached NULL node
+// is a negative entry, the name is known not to exist. Filesystems must invalidate entries when their tree changes.
+
+typedef struct
+{
+    list_entry_t entry;
+    uint64_t hash;
+    const void* parent;
+    stat_type_t type;
+    char name[MAX_NAME];
+    void* node;
+} dentry_t;
+
+typedef struct
+{
+    list_t entries;
+    uint64_t amount;
+} dcache_bucket_t;
+
+void dcache_init(void);
+
+// Returns true on a hit, a hit can be negative in which case node is set to NULL.
+bool dcache_lookup(const void* parent, const char* name, stat_type_t type, void** node);
+
+void dcache_insert(const void* parent, const char* name, stat_type_t type, void* node);
+
+void dcache_invalidate(const void* parent, const char* name, stat_type_t type);
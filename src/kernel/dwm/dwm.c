@@ -3,18 +3,22 @@
 #include <errno.h>
 #include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/dwm.h>
 #include <sys/gfx.h>
 #include <sys/io.h>
 #include <sys/math.h>
 #include <sys/mouse.h>
 
+#include "config.h"
 #include "lock.h"
 #include "log.h"
 #include "msg_queue.h"
 #include "sched.h"
+#include "smp.h"
 #include "sysfs.h"
 #include "time.h"
+#include "trap.h"
 #include "vfs.h"
 #include "window.h"
 
@@ -29,7 +33,26 @@ static window_t* selected;
 static window_t* cursor;
 static window_t* wall;
 
+// The cursor is never drawn into the backbuffer, instead it is composited into this cursor sized plane on top of the
+// backbuffer pixels below it and written straight to the frontbuffer. The backbuffer doubles as the backing store used
+// to restore the frontbuffer once the cursor moves away.
+static gfx_t cursorPlane;
+// Premultiplied copy of the cursor surface, refreshed only when the client redraws the cursor, so that compositing it on
+// every mouse movement skips its transparent and opaque runs and needs no divisions for the translucent rest.
+static gfx_t cursorImage;
+
+typedef struct
+{
+    mouse_buttons_t held;
+    point_t delta;
+} dwm_mouse_t;
+
+// Mouse input waiting for the next frame, motion with the same buttons held is merged into one entry but every button
+// change gets its own so that a press and release within one frame are both delivered.
 static file_t* mouse;
+static lock_t mouseLock;
+static dwm_mouse_t mouseEvents[CONFIG_DWM_MOUSE_EVENTS];
+static uint64_t mouseAmount;
 
 static lock_t lock;
 
@@ -37,6 +60,44 @@ static atomic_bool redrawNeeded;
 
 static blocker_t blocker;
 
+static dwm_stats_t stats;
+static nsec_t lastFrameStart;
+static atomic_uint64_t redraws;
+
+// Scratch space for dwm_clip(), only used by the compositing thread.
+static rect_t visible[CONFIG_DWM_MAX_VISIBLE];
+static uint64_t visibleAmount;
+
+// A deferred transfer into the backbuffer, recorded while walking the window stack and executed in parallel by
+// dwm_execute().
+typedef struct
+{
+    const gfx_t* src;
+    rect_t rect;
+    point_t srcPoint;
+    bool blend;
+} dwm_op_t;
+
+// Private copies of the back and frontbuffer so that the invalid regions updated by the gfx functions do not race.
+typedef struct
+{
+    gfx_t backbuffer;
+    gfx_t frontbuffer;
+} dwm_target_t;
+
+static dwm_op_t ops[CONFIG_DWM_MAX_OPS];
+static uint64_t opAmount;
+static region_t swapRegion;
+
+static dwm_target_t target;
+static uint64_t tileAmount;
+static atomic_uint64_t nextTile;
+static atomic_uint64_t doneTiles;
+
+static uint64_t workerAmount;
+static atomic_uint64_t generation;
+static blocker_t workBlocker;
+
 static void dwm_update_client_rect_unlocked(void)
 {
     rect_t newRect = RECT_INIT_DIM(0, 0, backbuffer.width, backbuffer.height);
@@ -106,19 +167,217 @@ static void dwm_select(window_t* window)
     }
 }
 
+static void dwm_render_tiles(dwm_target_t* target)
+{
+    while (1)
+    {
+        // A tile is claimed and rendered with interrupts disabled so that a worker cannot be preempted while holding one,
+        // the compositing thread never waits on more than one tile per worker.
+        cli_push();
+        uint64_t tile = atomic_fetch_add(&nextTile, 1);
+        if (tile >= tileAmount)
+        {
+            cli_pop();
+            return;
+        }
+
+        rect_t tileRect = RECT_INIT(0, tile * CONFIG_DWM_TILE_HEIGHT, backbuffer.width,
+            MIN((tile + 1) * CONFIG_DWM_TILE_HEIGHT, backbuffer.height));
+
+        // Ops are executed in recorded order within each tile, so overlapping ops end up the same as if drawn serially.
+        for (uint64_t i = 0; i < opAmount; i++)
+        {
+            const dwm_op_t* op = &ops[i];
+            if (!RECT_OVERLAP(&op->rect, &tileRect))
+            {
+                continue;
+            }
+
+            rect_t rect = op->rect;
+            RECT_FIT(&rect, &tileRect);
+            point_t srcPoint = {
+                .x = op->srcPoint.x + (rect.left - op->rect.left),
+                .y = op->srcPoint.y + (rect.top - op->rect.top),
+            };
+
+            if (op->blend)
+            {
+                gfx_transfer_blend(&target->backbuffer, op->src, &rect, &srcPoint);
+            }
+            else
+            {
+                gfx_transfer(&target->backbuffer, op->src, &rect, &srcPoint);
+            }
+        }
+
+        for (uint8_t i = 0; i < swapRegion.count; i++)
+        {
+            if (!RECT_OVERLAP(&swapRegion.rects[i], &tileRect))
+            {
+                continue;
+            }
+
+            rect_t rect = swapRegion.rects[i];
+            RECT_FIT(&rect, &tileRect);
+            gfx_swap(&target->frontbuffer, &target->backbuffer, &rect);
+        }
+
+        target->backbuffer.invalidRegion = REGION_INIT();
+        target->frontbuffer.invalidRegion = REGION_INIT();
+        atomic_fetch_add(&doneTiles, 1);
+        cli_pop();
+    }
+}
+
+// Fork/join over all tiles, executes the recorded ops and then swaps swapRegion. The compositing thread holds the
+// global lock with interrupts disabled so it cannot block, instead it renders tiles alongside the workers and then spins
+// until the tiles claimed by workers are finished, which is bounded since workers render a tile without being preempted.
+// A worker that wakes up late simply finds no tiles left.
+static void dwm_execute(void)
+{
+    atomic_store(&doneTiles, 0);
+    atomic_store(&nextTile, 0);
+    if (workerAmount != 0)
+    {
+        atomic_fetch_add(&generation, 1);
+        sched_unblock(&workBlocker);
+    }
+
+    dwm_render_tiles(&target);
+
+    while (atomic_load(&doneTiles) != tileAmount)
+    {
+        asm volatile("pause");
+    }
+    opAmount = 0;
+}
+
+static void dwm_worker_loop(void)
+{
+    dwm_target_t* target = malloc(sizeof(dwm_target_t));
+    LOG_ASSERT(target != NULL, "dwm worker alloc fail");
+    target->backbuffer = backbuffer;
+    target->frontbuffer = frontbuffer;
+
+    uint64_t seen = 0;
+    while (1)
+    {
+        SCHED_BLOCK(&workBlocker, atomic_load(&generation) != seen);
+        seen = atomic_load(&generation);
+
+        dwm_render_tiles(target);
+    }
+}
+
+static void dwm_queue(const gfx_t* src, const rect_t* rect, const point_t* srcPoint, bool blend)
+{
+    if (RECT_WIDTH(rect) <= 0 || RECT_HEIGHT(rect) <= 0)
+    {
+        return;
+    }
+
+    if (opAmount == CONFIG_DWM_MAX_OPS)
+    {
+        // Window buffers cannot change while the global lock is held, so a full batch can be executed early, swapping
+        // is left for the end of the frame.
+        region_t pending = swapRegion;
+        swapRegion = REGION_INIT();
+        dwm_execute();
+        swapRegion = pending;
+    }
+
+    ops[opAmount++] = (dwm_op_t){
+        .src = src,
+        .rect = *rect,
+        .srcPoint = *srcPoint,
+        .blend = blend,
+    };
+    region_add(&backbuffer.invalidRegion, rect);
+}
+
 static void dwm_transfer(window_t* window, const rect_t* rect)
 {
     point_t srcPoint = {
         .x = rect->left - window->pos.x,
         .y = rect->top - window->pos.y,
     };
-    gfx_transfer(&backbuffer, &window->gfx, rect, &srcPoint);
+    dwm_queue(&window->gfx, rect, &srcPoint, false);
+}
+
+// Splits rect into the pieces not covered by any window from start to the top of the stack, all windows are opaque
+// except the cursor which is not part of the stack. Returns false if rect splits into too many pieces.
+static bool dwm_clip(list_entry_t* start, window_t* exclude, const rect_t* rect)
+{
+    visible[0] = *rect;
+    visibleAmount = RECT_WIDTH(rect) > 0 && RECT_HEIGHT(rect) > 0 ? 1 : 0;
+
+    window_t* other;
+    LIST_FOR_EACH_FROM(other, start, &windows)
+    {
+        if (visibleAmount == 0)
+        {
+            return true;
+        }
+
+        if (other == exclude)
+        {
+            continue;
+        }
+
+        rect_t otherRect;
+        lock_acquire(&other->lock);
+        otherRect = WINDOW_RECT(other);
+        RECT_FIT(&otherRect, other->type == DWM_WINDOW ? &clientRect : &screenRect);
+        lock_release(&other->lock);
+
+        // Pieces produced by a subtraction no longer overlap otherRect so they are skipped when reached.
+        uint64_t i = 0;
+        while (i < visibleAmount)
+        {
+            if (!RECT_OVERLAP(&visible[i], &otherRect))
+            {
+                i++;
+                continue;
+            }
+
+            rect_subtract_t subtract;
+            RECT_SUBTRACT(&subtract, &visible[i], &otherRect);
+            if (visibleAmount - 1 + subtract.count > CONFIG_DWM_MAX_VISIBLE)
+            {
+                return false;
+            }
+
+            visible[i] = visible[--visibleAmount];
+            for (uint64_t j = 0; j < subtract.count; j++)
+            {
+                visible[visibleAmount++] = subtract.rects[j];
+            }
+        }
+    }
+
+    return true;
+}
+
+// Returns false if the whole rect had to be transferred, in which case windows above it must be redrawn.
+static bool dwm_transfer_visible(window_t* window, list_entry_t* above, window_t* exclude, const rect_t* rect)
+{
+    if (!dwm_clip(above, exclude, rect))
+    {
+        dwm_transfer(window, rect);
+        return false;
+    }
+
+    for (uint64_t i = 0; i < visibleAmount; i++)
+    {
+        dwm_transfer(window, &visible[i]);
+    }
+    return true;
 }
 
 static void dwm_redraw_others(window_t* window, const rect_t* rect)
 {
-    point_t srcPoint = {0};
-    gfx_transfer(&backbuffer, &wall->gfx, rect, &srcPoint);
+    // Windows are visited bottom to top so falling back to overdrawing a piece still ends up correct.
+    dwm_transfer_visible(wall, windows.head.next, window, rect);
 
     window_t* other;
     LIST_FOR_EACH(other, &windows)
@@ -136,7 +395,7 @@ static void dwm_redraw_others(window_t* window, const rect_t* rect)
             RECT_FIT(&overlapRect, &otherRect);
             RECT_FIT(&overlapRect, other->type == DWM_WINDOW ? &clientRect : &screenRect);
 
-            dwm_transfer(other, &overlapRect);
+            dwm_transfer_visible(other, other->entry.next, window, &overlapRect);
         }
     }
 }
@@ -164,10 +423,30 @@ static void dwm_invalidate_above(window_t* window, const rect_t* rect)
     }
 }
 
+static bool dwm_damaged(const rect_t* rect)
+{
+    for (uint8_t i = 0; i < backbuffer.invalidRegion.count; i++)
+    {
+        if (RECT_OVERLAP(&backbuffer.invalidRegion.rects[i], rect))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 static void dwm_swap(void)
 {
-    gfx_swap(&frontbuffer, &backbuffer, &backbuffer.invalidRect);
-    backbuffer.invalidRect = (rect_t){0};
+    if (opAmount == 0 && backbuffer.invalidRegion.count == 0)
+    {
+        return;
+    }
+
+    swapRegion = backbuffer.invalidRegion;
+    dwm_execute();
+    swapRegion = REGION_INIT();
+    backbuffer.invalidRegion = REGION_INIT();
+    frontbuffer.invalidRegion = REGION_INIT();
 }
 
 static void dwm_draw_wall(void)
@@ -182,7 +461,7 @@ static void dwm_draw_wall(void)
 
     rect_t wallRect = WINDOW_RECT(wall);
     RECT_FIT(&wallRect, &clientRect);
-    dwm_transfer(wall, &wallRect);
+    dwm_transfer_visible(wall, windows.head.next, NULL, &wallRect);
 
     window_t* window;
     LIST_FOR_EACH(window, &windows)
@@ -206,22 +485,37 @@ static void dwm_draw_windows(void)
             rect = WINDOW_RECT(window);
             RECT_FIT(&rect, fitRect);
 
+            // Only the strips of the previous rect that the window no longer covers expose what is below it, the rest
+            // is overwritten by the window itself.
             rect_subtract_t subtract;
             RECT_SUBTRACT(&subtract, &window->prevRect, &rect);
 
             for (uint64_t i = 0; i < subtract.count; i++)
             {
-                dwm_redraw_others(window, &window->prevRect);
+                dwm_redraw_others(window, &subtract.rects[i]);
             }
 
             window->moved = false;
             window->invalid = false;
             window->prevRect = rect;
+
+            if (!dwm_transfer_visible(window, window->entry.next, NULL, &rect))
+            {
+                dwm_invalidate_above(window, &rect);
+            }
         }
         else if (window->invalid)
         {
-            rect = WINDOW_INVALID_RECT(window);
-            RECT_FIT(&rect, fitRect);
+            for (uint8_t i = 0; i < window->gfx.invalidRegion.count; i++)
+            {
+                rect = WINDOW_TO_SCREEN_RECT(window, &window->gfx.invalidRegion.rects[i]);
+                RECT_FIT(&rect, fitRect);
+
+                if (!dwm_transfer_visible(window, window->entry.next, NULL, &rect))
+                {
+                    dwm_invalidate_above(window, &rect);
+                }
+            }
 
             window->invalid = false;
         }
@@ -230,20 +524,71 @@ static void dwm_draw_windows(void)
             continue;
         }
 
-        dwm_transfer(window, &rect);
-        dwm_invalidate_above(window, &rect);
-        window->gfx.invalidRect = (rect_t){0};
+        window->gfx.invalidRegion = REGION_INIT();
     }
 }
 
-static void dwm_draw_cursor(void)
+static void dwm_draw_cursor(bool damaged)
 {
     LOCK_GUARD(&cursor->lock);
 
-    point_t srcPoint = {0};
     rect_t cursorRect = WINDOW_RECT(cursor);
     RECT_FIT(&cursorRect, &screenRect);
-    gfx_transfer_blend(&backbuffer, &cursor->gfx, &cursorRect, &srcPoint);
+    if (!damaged && !cursor->invalid && !cursor->moved && RECT_EQUAL(&cursorRect, &cursor->prevRect))
+    {
+        return;
+    }
+
+    bool stale = cursor->invalid;
+    if (cursorPlane.width != cursor->gfx.width || cursorPlane.height != cursor->gfx.height)
+    {
+        uint64_t pixelAmount = (uint64_t)cursor->gfx.width * cursor->gfx.height;
+        pixel_t* buffer = malloc(pixelAmount * 2 * sizeof(pixel_t));
+        if (buffer == NULL)
+        {
+            return;
+        }
+
+        free(cursorPlane.buffer);
+        cursorPlane.buffer = buffer;
+        cursorPlane.width = cursor->gfx.width;
+        cursorPlane.height = cursor->gfx.height;
+        cursorPlane.stride = cursor->gfx.width;
+        cursorImage = cursorPlane;
+        cursorImage.buffer = &buffer[pixelAmount];
+        stale = true;
+    }
+
+    if (stale)
+    {
+        rect_t imageRect = RECT_INIT_GFX(&cursorImage);
+        point_t zeroPoint = {0};
+        gfx_transfer(&cursorImage, &cursor->gfx, &imageRect, &zeroPoint);
+        gfx_premultiply(&cursorImage);
+        cursorImage.invalidRegion = REGION_INIT();
+    }
+
+    // Only the parts of the old position that the new one does not cover are restored, to avoid flicker.
+    rect_subtract_t subtract;
+    RECT_SUBTRACT(&subtract, &cursor->prevRect, &cursorRect);
+    for (uint64_t i = 0; i < subtract.count; i++)
+    {
+        gfx_swap(&frontbuffer, &backbuffer, &subtract.rects[i]);
+    }
+
+    rect_t planeRect = RECT_INIT_DIM(0, 0, RECT_WIDTH(&cursorRect), RECT_HEIGHT(&cursorRect));
+    point_t screenPoint = {.x = cursorRect.left, .y = cursorRect.top};
+    point_t zeroPoint = {0};
+    gfx_transfer(&cursorPlane, &backbuffer, &planeRect, &screenPoint);
+    gfx_transfer_blend(&cursorPlane, &cursorImage, &planeRect, &zeroPoint);
+    gfx_transfer(&frontbuffer, &cursorPlane, &cursorRect, &zeroPoint);
+
+    cursor->invalid = false;
+    cursor->moved = false;
+    cursor->prevRect = cursorRect;
+    cursor->gfx.invalidRegion = REGION_INIT();
+    cursorPlane.invalidRegion = REGION_INIT();
+    frontbuffer.invalidRegion = REGION_INIT();
 }
 
 static void dwm_handle_mouse_message(mouse_buttons_t held, const point_t* delta)
@@ -255,22 +600,12 @@ static void dwm_handle_mouse_message(mouse_buttons_t held, const point_t* delta)
     mouse_buttons_t pressed = (held & ~oldHeld);
     mouse_buttons_t released = (oldHeld & ~held);
 
+    // The cursor plane is updated at the end of the frame, moving the cursor does not damage the backbuffer.
     point_t oldPos = cursor->pos;
     if (delta->x != 0 || delta->y != 0)
     {
-        rect_t oldRect = WINDOW_RECT(cursor);
-        RECT_FIT(&oldRect, &screenRect);
-        dwm_redraw_others(cursor, &oldRect);
-
         cursor->pos.x = CLAMP(cursor->pos.x + delta->x, 0, backbuffer.width - 1);
         cursor->pos.y = CLAMP(cursor->pos.y + delta->y, 0, backbuffer.height - 1);
-
-        point_t srcPoint = {0};
-        rect_t cursorRect = WINDOW_RECT(cursor);
-        RECT_FIT(&cursorRect, &screenRect);
-        gfx_transfer_blend(&backbuffer, &cursor->gfx, &cursorRect, &srcPoint);
-
-        dwm_swap();
     }
 
     if (pressed != MOUSE_NONE)
@@ -309,61 +644,99 @@ static void dwm_handle_mouse_message(mouse_buttons_t held, const point_t* delta)
     oldHeld = held;
 }
 
-static void dwm_poll(void)
+static void dwm_handle_mouse(void)
 {
-    while (!atomic_exchange_explicit(&redrawNeeded, false, __ATOMIC_RELAXED))
-    {
-        sched_block_begin(&blocker);
-        sched_block_do(&blocker, SEC / 1000);
-        sched_block_end(&blocker);
+    dwm_mouse_t events[CONFIG_DWM_MOUSE_EVENTS];
 
-        if (cursor == NULL)
-        {
-            continue;
-        }
+    lock_acquire(&mouseLock);
+    uint64_t amount = mouseAmount;
+    memcpy(events, mouseEvents, amount * sizeof(dwm_mouse_t));
+    mouseAmount = 0;
+    lock_release(&mouseLock);
 
-        mouse_buttons_t held = MOUSE_NONE;
-        point_t delta = {0};
-        bool recived = false;
-
-        poll_file_t poll[] = {{.file = mouse, .requested = POLL_READ}};
-        while (vfs_poll(poll, 1, 0) != 0)
-        {
-            mouse_event_t event;
-            LOG_ASSERT(vfs_read(mouse, &event, sizeof(mouse_event_t)) == sizeof(mouse_event_t), "mouse read fail");
+    if (cursor == NULL)
+    {
+        return;
+    }
 
-            delta.x += event.delta.x;
-            delta.y += event.delta.y;
-            held |= event.buttons;
+    for (uint64_t i = 0; i < amount; i++)
+    {
+        dwm_handle_mouse_message(events[i].held, &events[i].delta);
+    }
+}
 
-            recived = true;
-        }
+// Blocks on the mouse instead of polling it, input is accumulated until the next frame picks it up.
+static void dwm_mouse_loop(void)
+{
+    while (1)
+    {
+        mouse_event_t event;
+        LOG_ASSERT(vfs_read(mouse, &event, sizeof(mouse_event_t)) == sizeof(mouse_event_t), "mouse read fail");
 
-        if (recived)
+        lock_acquire(&mouseLock);
+        dwm_mouse_t* last = mouseAmount != 0 ? &mouseEvents[mouseAmount - 1] : NULL;
+        if (last == NULL || (last->held != event.buttons && mouseAmount < CONFIG_DWM_MOUSE_EVENTS))
         {
-            dwm_handle_mouse_message(held, &delta);
+            last = &mouseEvents[mouseAmount++];
+            *last = (dwm_mouse_t){.held = event.buttons};
         }
+        // If the queue is full the latest button state wins, so a button can never be left held.
+        last->held = event.buttons;
+        last->delta.x += event.delta.x;
+        last->delta.y += event.delta.y;
+        lock_release(&mouseLock);
+
+        dwm_redraw();
     }
 }
 
+static void dwm_stats_update(nsec_t frameStart, nsec_t frameEnd)
+{
+    nsec_t frameTime = frameEnd - frameStart;
+
+    stats.frames++;
+    stats.lastFrameTime = frameTime;
+    stats.maxFrameTime = MAX(stats.maxFrameTime, frameTime);
+    stats.totalFrameTime += frameTime;
+    stats.lastFrameInterval = lastFrameStart != 0 ? frameStart - lastFrameStart : 0;
+    lastFrameStart = frameStart;
+}
+
 static void dwm_loop(void)
 {
+    nsec_t nextFrame = 0;
     while (1)
     {
+        SCHED_BLOCK(&blocker, atomic_load(&redrawNeeded));
+
+        // There is no vblank signal for the gop framebuffer, so frames are paced to a fixed interval instead. Damage that
+        // arrives before the next frame is due is coalesced into that frame.
+        nsec_t uptime = time_uptime();
+        if (uptime < nextFrame)
+        {
+            sched_sleep(nextFrame - uptime);
+        }
+        atomic_store(&redrawNeeded, false);
+
+        nsec_t frameStart = time_uptime();
         lock_acquire(&lock);
+        dwm_handle_mouse();
         if (wall != NULL)
         {
             dwm_draw_wall();
             dwm_draw_windows();
+
+            bool cursorDamaged = cursor != NULL && dwm_damaged(&cursor->prevRect);
+            dwm_swap();
             if (cursor != NULL)
             {
-                dwm_draw_cursor();
+                dwm_draw_cursor(cursorDamaged);
             }
-            dwm_swap();
         }
+        dwm_stats_update(frameStart, time_uptime());
         lock_release(&lock);
 
-        dwm_poll();
+        nextFrame = frameStart + SEC / CONFIG_DWM_HZ;
     }
 }
 
@@ -395,6 +768,9 @@ static void dwm_window_cleanup(window_t* window)
     {
         log_print("dwm: cleanup cursor");
         cursor = NULL;
+
+        // Restores the frontbuffer below the cursor on the next swap.
+        region_add(&backbuffer.invalidRegion, &window->prevRect);
     }
     break;
     case DWM_WALL:
@@ -417,77 +793,92 @@ static void dwm_window_cleanup(window_t* window)
     dwm_redraw();
 }
 
-static uint64_t dwm_ioctl(file_t* file, uint64_t request, void* argp, uint64_t size)
+// The window and its surface are allocated before the dwm lock is taken, only publishing it happens under the lock and a
+// window that is rejected is freed once the lock is released.
+static uint64_t dwm_create(file_t* file, const ioctl_dwm_create_t* create)
 {
-    LOCK_GUARD(&lock);
-
-    switch (request)
+    window_t* window = window_new(&create->pos, create->width, create->height, create->type, dwm_window_cleanup);
+    if (window == NULL)
     {
-    case IOCTL_DWM_CREATE:
-    {
-        if (size != sizeof(ioctl_dwm_create_t))
-        {
-            return ERROR(EINVAL);
-        }
-        const ioctl_dwm_create_t* create = argp;
+        return ERR;
+    }
 
-        window_t* window = window_new(&create->pos, create->width, create->height, create->type, dwm_window_cleanup);
-        if (window == NULL)
-        {
-            return ERR;
-        }
-        LOCK_GUARD(&window->lock);
+    lock_acquire(&lock);
+    lock_acquire(&window->lock);
 
-        switch (window->type)
-        {
-        case DWM_WINDOW:
-        {
-            list_push(&windows, window);
-            dwm_select(window);
-            log_print("dwm: create window");
-        }
-        break;
-        case DWM_PANEL:
-        {
-            list_push(&windows, window);
-            dwm_update_client_rect_unlocked();
-            dwm_select(window);
-            log_print("dwm: create panel");
-        }
-        break;
-        case DWM_CURSOR:
+    bool exists = false;
+    switch (window->type)
+    {
+    case DWM_WINDOW:
+    {
+        list_push(&windows, window);
+        dwm_select(window);
+        log_print("dwm: create window");
+    }
+    break;
+    case DWM_PANEL:
+    {
+        list_push(&windows, window);
+        dwm_update_client_rect_unlocked();
+        dwm_select(window);
+        log_print("dwm: create panel");
+    }
+    break;
+    case DWM_CURSOR:
+    {
+        exists = cursor != NULL;
+        if (!exists)
         {
-            if (cursor != NULL)
-            {
-                window_free(window);
-                return ERROR(EEXIST);
-            }
-
             cursor = window;
             log_print("dwm: create cursor");
         }
-        break;
-        case DWM_WALL:
+    }
+    break;
+    case DWM_WALL:
+    {
+        exists = wall != NULL;
+        if (!exists)
         {
-            if (wall != NULL)
-            {
-                window_free(window);
-                return ERROR(EEXIST);
-            }
-
             wall = window;
             log_print("dwm: create wall");
         }
-        break;
-        default:
-        {
-            log_panic(NULL, "Invalid window type %d", window->type);
-        }
-        }
+    }
+    break;
+    default:
+    {
+        log_panic(NULL, "Invalid window type %d", window->type);
+    }
+    }
 
+    if (!exists)
+    {
         window_populate_file(window, file);
         dwm_redraw();
-        return 0;
+    }
+
+    lock_release(&window->lock);
+    lock_release(&lock);
+
+    if (exists)
+    {
+        window_free(window);
+        return ERROR(EEXIST);
+    }
+    return 0;
+}
+
+static uint64_t dwm_ioctl(file_t* file, uint64_t request, void* argp, uint64_t size)
+{
+    switch (request)
+    {
+    case IOCTL_DWM_CREATE:
+    {
+        if (size != sizeof(ioctl_dwm_create_t))
+        {
+            return ERROR(EINVAL);
+        }
+
+        return dwm_create(file, argp);
     }
     case IOCTL_DWM_SIZE:
     {
@@ -496,6 +887,7 @@ static uint64_t dwm_ioctl(file_t* file, uint64_t request, void* argp, uint64_t s
             return ERROR(EINVAL);
         }
 
+        LOCK_GUARD(&lock);
         ioctl_dwm_size_t* size = argp;
         size->outWidth = RECT_WIDTH(&screenRect);
         size->outHeight = RECT_HEIGHT(&screenRect);
@@ -512,6 +904,29 @@ static file_ops_t fileOps = {
     .ioctl = dwm_ioctl,
 };
 
+static uint64_t dwm_stats_read(file_t* file, void* buffer, uint64_t count)
+{
+    dwm_stats_t snapshot;
+    lock_acquire(&lock);
+    snapshot = stats;
+    lock_release(&lock);
+    snapshot.redraws = atomic_load(&redraws);
+
+    if (file->pos >= sizeof(dwm_stats_t))
+    {
+        return 0;
+    }
+
+    count = MIN(count, sizeof(dwm_stats_t) - file->pos);
+    memcpy(buffer, (uint8_t*)&snapshot + file->pos, count);
+    file->pos += count;
+    return count;
+}
+
+static file_ops_t statsOps = {
+    .read = dwm_stats_read,
+};
+
 void dwm_init(gop_buffer_t* gopBuffer)
 {
     log_print("dwm: %dx%d", (uint64_t)gopBuffer->width, (uint64_t)gopBuffer->height);
@@ -534,15 +949,36 @@ void dwm_init(gop_buffer_t* gopBuffer)
 
     cursor = NULL;
     wall = NULL;
+    cursorPlane = (gfx_t){0};
+    cursorImage = (gfx_t){0};
 
     lock_init(&lock);
 
     mouse = vfs_open("sys:/mouse/ps2");
+    lock_init(&mouseLock);
+    mouseAmount = 0;
 
     atomic_init(&redrawNeeded, true);
     blocker_init(&blocker);
 
+    opAmount = 0;
+    swapRegion = REGION_INIT();
+    target.backbuffer = backbuffer;
+    target.frontbuffer = frontbuffer;
+    tileAmount = (backbuffer.height + CONFIG_DWM_TILE_HEIGHT - 1) / CONFIG_DWM_TILE_HEIGHT;
+    atomic_init(&nextTile, 0);
+    atomic_init(&doneTiles, 0);
+
+    workerAmount = 0;
+    atomic_init(&generation, 0);
+    blocker_init(&workBlocker);
+
+    stats = (dwm_stats_t){0};
+    lastFrameStart = 0;
+    atomic_init(&redraws, 0);
+
     sysfs_expose("/", "dwm", &fileOps, NULL, NULL, NULL);
+    sysfs_expose("/", "dwm_stats", &statsOps, NULL, NULL, NULL);
 }
 
 void dwm_start(void)
@@ -552,15 +988,38 @@ void dwm_start(void)
     rect_t rect = RECT_INIT_GFX(&backbuffer);
     gfx_swap(&backbuffer, &frontbuffer, &rect);
 
-    sched_thread_spawn(dwm_loop, THREAD_PRIORITY_MAX);
+    // The compositing thread stays on the first cpu and renders tiles itself, every other cpu gets a worker pinned to it
+    // so that a worker is never queued behind the compositing thread, which does not yield while it waits for them.
+    workerAmount = smp_cpu_amount() - 1;
+    for (uint64_t i = 0; i < workerAmount; i++)
+    {
+        sched_thread_spawn_on(dwm_worker_loop, THREAD_PRIORITY_MAX, i + 1);
+    }
+
+    sched_thread_spawn_on(dwm_loop, THREAD_PRIORITY_MAX, 0);
+    if (mouse != NULL)
+    {
+        sched_thread_spawn(dwm_mouse_loop, THREAD_PRIORITY_MAX);
+    }
 }
 
 void dwm_redraw(void)
 {
+    atomic_fetch_add(&redraws, 1);
     atomic_store(&redrawNeeded, true);
     sched_unblock(&blocker);
 }
 
+void dwm_lock(void)
+{
+    lock_acquire(&lock);
+}
+
+void dwm_unlock(void)
+{
+    lock_release(&lock);
+}
+
 void dwm_update_client_rect(void)
 {
     LOCK_GUARD(&lock);
@@ -11,3 +11,9 @@ void dwm_start(void);
 void dwm_redraw(void);
 
 void dwm_update_client_rect(void);
+
+// Held while compositing, must be acquired before any window lock. Window surfaces may only be replaced while holding it
+// since the compositor reads them without taking window locks.
+void dwm_lock(void);
+
+void dwm_unlock(void);
@@ -1,16 +1,155 @@
 #include "msg_queue.h"
 
+#include "config.h"
 #include "lock.h"
 #include "sched.h"
 #include "time.h"
 
+#include <stdlib.h>
 #include <string.h>
+#include <sys/math.h>
+
+#define MSG_RECORD_SIZE(size) (sizeof(msg_record_t) + ROUND_UP(size, 8))
+
+// Stored in the size of a header to mark the rest of the buffer as unused, only written if there is room for a header.
+#define MSG_RECORD_SKIP UINT16_MAX
+
+static msg_record_t* msg_queue_front(msg_queue_t* queue)
+{
+    if (queue->capacity - queue->readOffset < sizeof(msg_record_t) ||
+        ((msg_record_t*)&queue->buffer[queue->readOffset])->size == MSG_RECORD_SKIP)
+    {
+        queue->readOffset = 0;
+    }
+
+    return (msg_record_t*)&queue->buffer[queue->readOffset];
+}
+
+static void msg_queue_advance(msg_queue_t* queue)
+{
+    msg_record_t* record = msg_queue_front(queue);
+    queue->readOffset += MSG_RECORD_SIZE(record->size);
+    queue->amount--;
+
+    if (queue->amount == 0)
+    {
+        queue->readOffset = 0;
+        queue->writeOffset = 0;
+        queue->last = NULL;
+    }
+}
+
+static msg_record_t* msg_queue_reserve(msg_queue_t* queue, uint64_t recordSize)
+{
+    if (queue->amount == 0)
+    {
+        return queue->capacity >= recordSize ? (msg_record_t*)queue->buffer : NULL;
+    }
+
+    if (queue->writeOffset > queue->readOffset)
+    {
+        if (queue->capacity - queue->writeOffset >= recordSize)
+        {
+            return (msg_record_t*)&queue->buffer[queue->writeOffset];
+        }
+
+        // The record does not fit at the end, wrap around if it fits before the oldest record.
+        if (recordSize > queue->readOffset)
+        {
+            return NULL;
+        }
+
+        if (queue->capacity - queue->writeOffset >= sizeof(msg_record_t))
+        {
+            ((msg_record_t*)&queue->buffer[queue->writeOffset])->size = MSG_RECORD_SKIP;
+        }
+        return (msg_record_t*)&queue->buffer[0];
+    }
+
+    // Equal offsets with messages pending means the buffer is full.
+    if (queue->readOffset - queue->writeOffset >= recordSize)
+    {
+        return (msg_record_t*)&queue->buffer[queue->writeOffset];
+    }
+
+    return NULL;
+}
+
+static uint64_t msg_queue_grow(msg_queue_t* queue)
+{
+    if (queue->capacity >= CONFIG_MSG_QUEUE_MAX)
+    {
+        return ERR;
+    }
+
+    uint64_t capacity = queue->capacity == 0 ? CONFIG_MSG_QUEUE_MIN : queue->capacity * 2;
+    uint8_t* buffer = malloc(capacity);
+    if (buffer == NULL)
+    {
+        return ERR;
+    }
+
+    // Messages are packed to the start of the new buffer in order.
+    uint64_t offset = 0;
+    uint64_t amount = queue->amount;
+    msg_record_t* last = NULL;
+    for (uint64_t i = 0; i < amount; i++)
+    {
+        msg_record_t* record = msg_queue_front(queue);
+        uint64_t recordSize = MSG_RECORD_SIZE(record->size);
+
+        last = (msg_record_t*)&buffer[offset];
+        memcpy(last, record, recordSize);
+        offset += recordSize;
+
+        queue->readOffset += recordSize;
+    }
+
+    free(queue->buffer);
+    queue->buffer = buffer;
+    queue->capacity = capacity;
+    queue->readOffset = 0;
+    queue->writeOffset = offset;
+    queue->last = last;
+    return 0;
+}
+
+// Consecutive mouse motion without any button changes is merged into the newest queued message, clicks are never merged.
+static bool msg_queue_coalesce(msg_queue_t* queue, msg_type_t type, const void* data, uint64_t size)
+{
+    if (queue->last == NULL || type != MSG_MOUSE || queue->last->type != MSG_MOUSE || size != sizeof(msg_mouse_t) ||
+        queue->last->size != sizeof(msg_mouse_t))
+    {
+        return false;
+    }
+
+    msg_mouse_t* last = (msg_mouse_t*)(queue->last + 1);
+    const msg_mouse_t* mouse = data;
+    if (last->pressed != MOUSE_NONE || last->released != MOUSE_NONE || mouse->pressed != MOUSE_NONE ||
+        mouse->released != MOUSE_NONE || last->held != mouse->held)
+    {
+        return false;
+    }
+
+    last->pos = mouse->pos;
+    last->delta.x += mouse->delta.x;
+    last->delta.y += mouse->delta.y;
+    queue->last->time = time_uptime();
+    return true;
+}
 
 void msg_queue_init(msg_queue_t* queue)
 {
-    memset(queue->queue, 0, sizeof(queue->queue));
-    queue->readIndex = 0;
-    queue->writeIndex = 0;
+    queue->buffer = NULL;
+    queue->capacity = 0;
+    queue->readOffset = 0;
+    queue->writeOffset = 0;
+    queue->amount = 0;
+    queue->last = NULL;
+    queue->pushed = 0;
+    queue->coalesced = 0;
+    queue->dropped = 0;
+    queue->maxAmount = 0;
     blocker_init(&queue->blocker);
     lock_init(&queue->lock);
 }
@@ -18,37 +157,106 @@ void msg_queue_init(msg_queue_t* queue)
 void msg_queue_cleanup(msg_queue_t* queue)
 {
     blocker_cleanup(&queue->blocker);
+    free(queue->buffer);
 }
 
 bool msg_queue_avail(msg_queue_t* queue)
 {
     LOCK_GUARD(&queue->lock);
-    return queue->readIndex != queue->writeIndex;
+    return queue->amount != 0;
 }
 
 void msg_queue_push(msg_queue_t* queue, msg_type_t type, const void* data, uint64_t size)
 {
     LOCK_GUARD(&queue->lock);
+    size = MIN(size, MSG_MAX_DATA);
+    queue->pushed++;
 
-    msg_t* msg = &queue->queue[queue->writeIndex];
-    msg->type = type;
-    msg->time = time_uptime();
-    memcpy(msg->data, data, size);
-    queue->writeIndex = (queue->writeIndex + 1) % MSG_QUEUE_MAX;
+    if (msg_queue_coalesce(queue, type, data, size))
+    {
+        queue->coalesced++;
+        sched_unblock(&queue->blocker);
+        return;
+    }
+
+    uint64_t recordSize = MSG_RECORD_SIZE(size);
+    msg_record_t* record = msg_queue_reserve(queue, recordSize);
+    while (record == NULL)
+    {
+        if (msg_queue_grow(queue) == ERR)
+        {
+            queue->dropped++;
+            return;
+        }
+        record = msg_queue_reserve(queue, recordSize);
+    }
+
+    record->time = time_uptime();
+    record->type = type;
+    record->size = size;
+    memcpy(record + 1, data, size);
+
+    queue->writeOffset = (uint64_t)((uint8_t*)record - queue->buffer) + recordSize;
+    queue->amount++;
+    queue->last = record;
+    queue->maxAmount = MAX(queue->maxAmount, queue->amount);
 
     sched_unblock(&queue->blocker);
 }
 
+static void msg_queue_read(msg_queue_t* queue, msg_t* msg)
+{
+    msg_record_t* record = msg_queue_front(queue);
+    *msg = (msg_t){.time = record->time, .type = record->type};
+    memcpy(msg->data, record + 1, record->size);
+
+    msg_queue_advance(queue);
+}
+
 void msg_queue_pop(msg_queue_t* queue, msg_t* msg, nsec_t timeout)
 {
-    if (SCHED_BLOCK_LOCK_TIMEOUT(&queue->blocker, &queue->lock, queue->readIndex != queue->writeIndex, timeout) != BLOCK_NORM)
+    if (SCHED_BLOCK_LOCK_TIMEOUT(&queue->blocker, &queue->lock, queue->amount != 0, timeout) != BLOCK_NORM)
     {
         *msg = (msg_t){.type = MSG_NONE};
         lock_release(&queue->lock);
         return;
     }
 
-    *msg = queue->queue[queue->readIndex];
-    queue->readIndex = (queue->readIndex + 1) % MSG_QUEUE_MAX;
+    msg_queue_read(queue, msg);
+    lock_release(&queue->lock);
+}
+
+uint64_t msg_queue_pop_many(msg_queue_t* queue, msg_t* msgs, uint64_t amount, nsec_t timeout)
+{
+    if (amount == 0)
+    {
+        return 0;
+    }
+
+    if (SCHED_BLOCK_LOCK_TIMEOUT(&queue->blocker, &queue->lock, queue->amount != 0, timeout) != BLOCK_NORM)
+    {
+        lock_release(&queue->lock);
+        return 0;
+    }
+
+    uint64_t count = 0;
+    while (count < amount && queue->amount != 0)
+    {
+        msg_queue_read(queue, &msgs[count++]);
+    }
+
     lock_release(&queue->lock);
+    return count;
+}
+
+void msg_queue_stats(msg_queue_t* queue, ioctl_window_stats_t* stats)
+{
+    LOCK_GUARD(&queue->lock);
+
+    stats->outPushed = queue->pushed;
+    stats->outCoalesced = queue->coalesced;
+    stats->outDropped = queue->dropped;
+    stats->outPending = queue->amount;
+    stats->outMaxPending = queue->maxAmount;
+    stats->outCapacity = queue->capacity;
 }
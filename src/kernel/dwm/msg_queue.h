@@ -5,13 +5,28 @@
 
 #include <sys/dwm.h>
 
-#define MSG_QUEUE_MAX 8
+// Header of a message stored in the queue, followed by size bytes of data padded to 8 bytes.
+typedef struct
+{
+    nsec_t time;
+    msg_type_t type;
+    uint16_t size;
+} msg_record_t;
 
+// Ring buffer of variable sized messages, grows by doubling up to CONFIG_MSG_QUEUE_MAX bytes. Records never wrap, the
+// unused tail of the buffer is skipped instead.
 typedef struct msg_queue
 {
-    msg_t queue[MSG_QUEUE_MAX];
-    uint8_t readIndex;
-    uint8_t writeIndex;
+    uint8_t* buffer;
+    uint64_t capacity;
+    uint64_t readOffset;
+    uint64_t writeOffset;
+    uint64_t amount;
+    msg_record_t* last;
+    uint64_t pushed;
+    uint64_t coalesced;
+    uint64_t dropped;
+    uint64_t maxAmount;
     blocker_t blocker;
     lock_t lock;
 } msg_queue_t;
@@ -25,3 +40,9 @@ bool msg_queue_avail(msg_queue_t* queue);
 void msg_queue_push(msg_queue_t* queue, msg_type_t type, const void* data, uint64_t size);
 
 void msg_queue_pop(msg_queue_t* queue, msg_t* msg, nsec_t timeout);
+
+// Blocks until at least one message is available or the timeout is reached, then pops up to amount messages. Returns the
+// amount of messages popped.
+uint64_t msg_queue_pop_many(msg_queue_t* queue, msg_t* msgs, uint64_t amount, nsec_t timeout);
+
+void msg_queue_stats(msg_queue_t* queue, ioctl_window_stats_t* stats);
@@ -3,7 +3,9 @@
 #include "dwm.h"
 #include "dwm/msg_queue.h"
 #include "lock.h"
+#include "sched.h"
 #include "vfs.h"
+#include "vmm.h"
 
 #include <errno.h>
 #include <stdlib.h>
@@ -11,6 +13,210 @@
 #include <sys/gfx.h>
 #include <sys/math.h>
 
+#define WINDOW_SURFACE_SIZE(width, height) ((uint64_t)(width) * (height) * sizeof(pixel_t))
+
+static pixel_t* window_surface_alloc(uint64_t capacity)
+{
+    if (capacity == 0)
+    {
+        return NULLPTR(EINVAL);
+    }
+
+    pixel_t* buffer = vmm_kernel_alloc(capacity);
+    if (buffer == NULL)
+    {
+        return NULL;
+    }
+
+    // The tail of the last page is visible to the client as well.
+    memset(buffer, 0, SIZE_IN_PAGES(capacity) * PAGE_SIZE);
+    return buffer;
+}
+
+// Pages the owner has since remapped to something else are left alone.
+static void window_surface_unmap(window_t* window)
+{
+    if (window->mapping == NULL)
+    {
+        return;
+    }
+
+    space_t* space = window->mappingSpace;
+    LOCK_GUARD(&space->lock);
+
+    for (uint64_t i = 0; i < window->mappingPages; i++)
+    {
+        void* userAddr = (void*)((uint64_t)window->mapping + i * PAGE_SIZE);
+        void* kernelAddr = (void*)((uint64_t)window->gfx.buffer + i * PAGE_SIZE);
+
+        if (pml_mapped(space->pml, userAddr, 1) &&
+            pml_phys_addr(space->pml, userAddr) == pml_phys_addr(vmm_kernel_pml(), kernelAddr))
+        {
+            pml_unmap(space->pml, userAddr, 1);
+        }
+    }
+
+    window->mapping = NULL;
+    window->mappingPages = 0;
+    window->mappingSpace = NULL;
+}
+
+static void window_surface_free(window_t* window)
+{
+    window_surface_unmap(window);
+    vmm_kernel_free(window->gfx.buffer, window->capacity);
+}
+
+// Returns the capacity a new surface of the given size needs, or 0 if the current one can be reused. A surface is only
+// replaced if it is too small or mostly unused, and grows geometrically so that live resizing rarely allocates.
+static uint64_t window_surface_capacity(window_t* window, uint64_t size)
+{
+    if (size <= window->capacity && size >= window->capacity / 4)
+    {
+        return 0;
+    }
+
+    uint64_t capacity = size > window->capacity ? MAX(size, window->capacity * 2) : size;
+    return ROUND_UP(capacity, PAGE_SIZE);
+}
+
+// Keeps the overlapping part of the old contents and clears the rest. Runs with the window lock held, so it never
+// allocates, if the current surface can not be reused it is swapped with `spare`, which must be cleared and at least
+// window_surface_capacity() large, and the old surface is handed back through `spare` to be freed after unlocking.
+static void window_surface_resize(window_t* window, uint32_t width, uint32_t height, pixel_t** spare,
+    uint64_t* spareCapacity)
+{
+    pixel_t* oldBuffer = window->gfx.buffer;
+    uint32_t oldWidth = window->gfx.width;
+    uint32_t copyWidth = MIN(width, oldWidth);
+    uint32_t copyHeight = MIN(height, window->gfx.height);
+
+    if (window_surface_capacity(window, WINDOW_SURFACE_SIZE(width, height)) != 0)
+    {
+        pixel_t* buffer = *spare;
+        for (uint32_t y = 0; y < copyHeight; y++)
+        {
+            memcpy(&buffer[y * width], &oldBuffer[y * oldWidth], copyWidth * sizeof(pixel_t));
+        }
+
+        // The old surface is unmapped from the client, it has to map the new one.
+        window_surface_unmap(window);
+        uint64_t capacity = *spareCapacity;
+        *spare = oldBuffer;
+        *spareCapacity = window->capacity;
+        window->gfx.buffer = buffer;
+        window->capacity = capacity;
+    }
+    else
+    {
+        // Rows move towards the start when narrowing and towards the end when widening, so they are visited in the
+        // order that never overwrites a row before it is moved.
+        if (width < oldWidth)
+        {
+            for (uint32_t y = 0; y < copyHeight; y++)
+            {
+                memmove(&oldBuffer[y * width], &oldBuffer[y * oldWidth], copyWidth * sizeof(pixel_t));
+            }
+        }
+        else if (width > oldWidth)
+        {
+            for (uint32_t y = copyHeight; y-- > 0;)
+            {
+                memmove(&oldBuffer[y * width], &oldBuffer[y * oldWidth], copyWidth * sizeof(pixel_t));
+            }
+        }
+
+        for (uint32_t y = 0; y < copyHeight; y++)
+        {
+            memset(&oldBuffer[y * width + copyWidth], 0, (width - copyWidth) * sizeof(pixel_t));
+        }
+        memset(&oldBuffer[copyHeight * width], 0, (uint64_t)(height - copyHeight) * width * sizeof(pixel_t));
+    }
+
+    window->gfx.width = width;
+    window->gfx.height = height;
+    window->gfx.stride = width;
+}
+
+// Moves and resizes happen under the dwm lock with interrupts disabled, so a surface that has to be replaced is allocated
+// and cleared beforehand and the size is checked again once the locks are held, the old surface is freed afterwards.
+static uint64_t window_move(window_t* window, const ioctl_window_move_t* move)
+{
+    if (WINDOW_SURFACE_SIZE(move->width, move->height) == 0)
+    {
+        return ERROR(EINVAL);
+    }
+
+    pixel_t* spare = NULL;
+    uint64_t spareCapacity = 0;
+    while (true)
+    {
+        dwm_lock();
+        lock_acquire(&window->lock);
+
+        // Drags send a move per mouse message, those that change nothing must not force a redraw.
+        if (window->pos.x == move->pos.x && window->pos.y == move->pos.y && window->gfx.width == move->width &&
+            window->gfx.height == move->height)
+        {
+            lock_release(&window->lock);
+            dwm_unlock();
+            if (spare != NULL)
+            {
+                vmm_kernel_free(spare, spareCapacity);
+            }
+            return 0;
+        }
+
+        uint64_t capacity = 0;
+        if (window->gfx.width != move->width || window->gfx.height != move->height)
+        {
+            capacity = window_surface_capacity(window, WINDOW_SURFACE_SIZE(move->width, move->height));
+        }
+        if (capacity <= spareCapacity)
+        {
+            break;
+        }
+
+        // Either the first pass or the window was resized by someone else in the meantime.
+        lock_release(&window->lock);
+        dwm_unlock();
+
+        if (spare != NULL)
+        {
+            vmm_kernel_free(spare, spareCapacity);
+        }
+        spare = window_surface_alloc(capacity);
+        if (spare == NULL)
+        {
+            return ERR;
+        }
+        spareCapacity = capacity;
+    }
+
+    window->pos = move->pos;
+    if (window->gfx.width != move->width || window->gfx.height != move->height)
+    {
+        window_surface_resize(window, move->width, move->height, &spare, &spareCapacity);
+    }
+
+    window->moved = true;
+    dwm_redraw();
+
+    lock_release(&window->lock);
+    dwm_unlock();
+
+    if (spare != NULL)
+    {
+        vmm_kernel_free(spare, spareCapacity);
+    }
+
+    if (window->type == DWM_PANEL)
+    {
+        dwm_update_client_rect();
+    }
+    return 0;
+}
+
 static void window_cleanup(file_t* file)
 {
     window_t* window = file->private;
@@ -36,6 +242,19 @@ static uint64_t window_ioctl(file_t* file, uint64_t request, void* argp, uint64_
         msg_queue_pop(&window->messages, &receive->outMsg, receive->timeout);
     }
     break;
+    case IOCTL_WINDOW_RECEIVE_MANY:
+    {
+        if (size < sizeof(ioctl_window_receive_many_t) ||
+            (size - sizeof(ioctl_window_receive_many_t)) % sizeof(msg_t) != 0)
+        {
+            return ERROR(EINVAL);
+        }
+        ioctl_window_receive_many_t* receive = argp;
+
+        uint64_t amount = (size - sizeof(ioctl_window_receive_many_t)) / sizeof(msg_t);
+        receive->outAmount = msg_queue_pop_many(&window->messages, receive->outMsgs, amount, receive->timeout);
+    }
+    break;
     case IOCTL_WINDOW_SEND:
     {
         if (size != sizeof(ioctl_window_send_t))
@@ -43,39 +262,34 @@ static uint64_t window_ioctl(file_t* file, uint64_t request, void* argp, uint64_
             return ERROR(EINVAL);
         }
         const ioctl_window_send_t* send = argp;
+        if (send->size > MSG_MAX_DATA)
+        {
+            return ERROR(EINVAL);
+        }
 
-        msg_queue_push(&window->messages, send->msg.type, send->msg.data, MSG_MAX_DATA);
+        msg_queue_push(&window->messages, send->msg.type, send->msg.data, send->size);
     }
     break;
-    case IOCTL_WINDOW_MOVE:
+    case IOCTL_WINDOW_STATS:
     {
-        if (size != sizeof(ioctl_window_move_t))
+        if (size != sizeof(ioctl_window_stats_t))
         {
             return ERROR(EINVAL);
         }
-        const ioctl_window_move_t* move = argp;
-
-        lock_acquire(&window->lock);
-        window->pos = move->pos;
 
-        if (window->gfx.width != move->width || window->gfx.height != move->height)
+        msg_queue_stats(&window->messages, argp);
+    }
+    break;
+    case IOCTL_WINDOW_MOVE:
+    {
+        if (size != sizeof(ioctl_window_move_t))
         {
-            window->gfx.width = move->width;
-            window->gfx.height = move->height;
-            window->gfx.stride = move->width;
-
-            free(window->gfx.buffer);
-            window->gfx.buffer = malloc(move->width * move->height * sizeof(pixel_t));
+            return ERROR(EINVAL);
         }
 
-        window->moved = true;
-        dwm_redraw();
-
-        lock_release(&window->lock);
-
-        if (window->type == DWM_PANEL)
+        if (window_move(window, argp) == ERR)
         {
-            dwm_update_client_rect();
+            return ERR;
         }
     }
     break;
@@ -93,7 +307,7 @@ static uint64_t window_flush(file_t* file, const pixel_t* buffer, uint64_t size,
     window_t* window = file->private;
     LOCK_GUARD(&window->lock);
 
-    if (size != window->gfx.width * window->gfx.height * sizeof(pixel_t))
+    if (buffer != NULL && size != WINDOW_SURFACE_SIZE(window->gfx.width, window->gfx.height))
     {
         return ERROR(EBUFFER);
     }
@@ -104,10 +318,14 @@ static uint64_t window_flush(file_t* file, const pixel_t* buffer, uint64_t size,
         return ERROR(EINVAL);
     }
 
-    for (int64_t y = 0; y < RECT_HEIGHT(rect); y++)
+    // Without a buffer the client drew directly into the mapped surface and is only reporting damage.
+    if (buffer != NULL)
     {
-        uint64_t index = rect->left + (rect->top + y) * window->gfx.stride;
-        memcpy(&window->gfx.buffer[index], &buffer[index], RECT_WIDTH(rect) * sizeof(pixel_t));
+        for (int64_t y = 0; y < RECT_HEIGHT(rect); y++)
+        {
+            uint64_t index = rect->left + (rect->top + y) * window->gfx.stride;
+            memcpy(&window->gfx.buffer[index], &buffer[index], RECT_WIDTH(rect) * sizeof(pixel_t));
+        }
     }
     gfx_invalidate(&window->gfx, rect);
 
@@ -116,6 +334,45 @@ static uint64_t window_flush(file_t* file, const pixel_t* buffer, uint64_t size,
     return 0;
 }
 
+static void* window_mmap(file_t* file, void* address, uint64_t length, prot_t prot)
+{
+    window_t* window = file->private;
+    LOCK_GUARD(&window->lock);
+
+    uint64_t pageAmount = SIZE_IN_PAGES(WINDOW_SURFACE_SIZE(window->gfx.width, window->gfx.height));
+    if (SIZE_IN_PAGES(length) != pageAmount)
+    {
+        return NULLPTR(EINVAL);
+    }
+
+    void** pages = malloc(sizeof(void*) * pageAmount);
+    if (pages == NULL)
+    {
+        return NULLPTR(ENOMEM);
+    }
+
+    for (uint64_t i = 0; i < pageAmount; i++)
+    {
+        void* kernelAddr = (void*)((uint64_t)window->gfx.buffer + i * PAGE_SIZE);
+        pages[i] = VMM_HIGHER_TO_LOWER(pml_phys_addr(vmm_kernel_pml(), kernelAddr));
+    }
+
+    // Only one mapping is tracked so it can be torn down when the surface goes away.
+    window_surface_unmap(window);
+
+    address = vmm_map_pages(address, pages, pageAmount, prot);
+    free(pages);
+    if (address == NULL)
+    {
+        return NULL;
+    }
+
+    window->mapping = address;
+    window->mappingPages = pageAmount;
+    window->mappingSpace = &sched_process()->space;
+    return address;
+}
+
 static uint64_t window_status(file_t* file, poll_file_t* pollFile)
 {
     window_t* window = file->private;
@@ -135,11 +392,22 @@ window_t* window_new(const point_t* pos, uint32_t width, uint32_t height, dwm_ty
     list_entry_init(&window->entry);
     window->pos = *pos;
     window->type = type;
-    window->gfx.buffer = calloc(width * height, sizeof(pixel_t));
+    window->capacity = ROUND_UP(WINDOW_SURFACE_SIZE(width, height), PAGE_SIZE);
+    window->gfx.buffer = window_surface_alloc(window->capacity);
+    if (window->gfx.buffer == NULL)
+    {
+        free(window);
+        return NULL;
+    }
+    window->mapping = NULL;
+    window->mappingPages = 0;
+    window->mappingSpace = NULL;
     window->gfx.width = width;
     window->gfx.height = height;
     window->gfx.stride = width;
-    window->gfx.invalidRect = RECT_INIT_DIM(0, 0, width, height);
+    window->gfx.flags = GFX_NONE;
+    window->gfx.invalidRegion = REGION_INIT();
+    gfx_invalidate(&window->gfx, &RECT_INIT_DIM(0, 0, width, height));
     window->invalid = false;
     window->moved = true;
     window->prevRect = RECT_INIT_DIM(0, 0, 0, 0);
@@ -153,7 +421,7 @@ window_t* window_new(const point_t* pos, uint32_t width, uint32_t height, dwm_ty
 void window_free(window_t* window)
 {
     msg_queue_cleanup(&window->messages);
-    free(window->gfx.buffer);
+    window_surface_free(window);
     free(window);
 }
 
@@ -161,6 +429,7 @@ static file_ops_t fileOps = {
     .cleanup = window_cleanup,
     .ioctl = window_ioctl,
     .flush = window_flush,
+    .mmap = window_mmap,
     .status = window_status,
 };
 
@@ -3,6 +3,7 @@
 #include "defs.h"
 #include "lock.h"
 #include "msg_queue.h"
+#include "space.h"
 #include "vfs.h"
 
 #include <sys/gfx.h>
@@ -13,6 +14,10 @@ typedef struct window
     list_entry_t entry;
     point_t pos;
     gfx_t gfx;
+    uint64_t capacity; // Size of the surface in bytes, may be larger than the current size.
+    void* mapping;
+    uint64_t mappingPages;
+    space_t* mappingSpace;
     dwm_type_t type;
     bool invalid;
     bool moved;
@@ -25,9 +30,8 @@ typedef struct window
 
 #define WINDOW_RECT(window) RECT_INIT_DIM(window->pos.x, window->pos.y, window->gfx.width, window->gfx.height);
 
-#define WINDOW_INVALID_RECT(window) \
-    RECT_INIT_DIM(window->pos.x + window->gfx.invalidRect.left, window->pos.y + window->gfx.invalidRect.top, \
-        RECT_WIDTH(&window->gfx.invalidRect), RECT_HEIGHT(&window->gfx.invalidRect));
+#define WINDOW_TO_SCREEN_RECT(window, rect) \
+    RECT_INIT_DIM(window->pos.x + (rect)->left, window->pos.y + (rect)->top, RECT_WIDTH(rect), RECT_HEIGHT(rect))
 
 window_t* window_new(const point_t* pos, uint32_t width, uint32_t height, dwm_type_t type, void (*cleanup)(window_t*));
 
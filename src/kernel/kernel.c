@@ -3,6 +3,7 @@
 #include "acpi.h"
 #include "apic.h"
 #include "const.h"
+#include "dcache.h"
 #include "dwm/dwm.h"
 #include "gdt.h"
 #include "hpet.h"
@@ -14,11 +15,13 @@
 #include "ps2/ps2.h"
 #include "ramfs.h"
 #include "regs.h"
+#include "ring.h"
 #include "sched.h"
 #include "simd.h"
 #include "smp.h"
 #include "sysfs.h"
 #include "time.h"
+#include "tmpfs.h"
 #include "vfs.h"
 #include "vmm.h"
 
@@ -56,6 +59,7 @@ void kernel_init(boot_info_t* bootInfo)
     sched_init();
 
     vfs_init();
+    dcache_init();
     sysfs_init();
 
     log_enable_screen(&bootInfo->gopBuffer);
@@ -75,8 +79,10 @@ void kernel_init(boot_info_t* bootInfo)
     sched_start();
 
     ramfs_init(bootInfo->ramRoot);
+    tmpfs_init();
 
     const_init();
+    ring_init();
     ps2_init();
     dwm_init(&bootInfo->gopBuffer);
 
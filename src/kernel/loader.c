@@ -51,7 +51,7 @@ static void* loader_load_program(void)
     }
 
     elf_hdr_t header;
-    if (vfs_read(file, &header, sizeof(elf_hdr_t)) != sizeof(elf_hdr_t))
+    if (vfs_pread(file, &header, sizeof(elf_hdr_t), 0) != sizeof(elf_hdr_t))
     {
         loader_error(file);
     }
@@ -63,13 +63,9 @@ static void* loader_load_program(void)
     for (uint64_t i = 0; i < header.programHeaderAmount; i++)
     {
         uint64_t offset = sizeof(elf_hdr_t) + header.programHeaderSize * i;
-        if (vfs_seek(file, offset, SEEK_SET) != offset)
-        {
-            loader_error(file);
-        }
 
         elf_phdr_t programHeader;
-        if (vfs_read(file, &programHeader, sizeof(elf_phdr_t)) != sizeof(elf_phdr_t))
+        if (vfs_pread(file, &programHeader, sizeof(elf_phdr_t), offset) != sizeof(elf_phdr_t))
         {
             loader_error(file);
         }
@@ -85,13 +81,9 @@ static void* loader_load_program(void)
                 loader_error(file);
             }
 
-            if (vfs_seek(file, programHeader.offset, SEEK_SET) != programHeader.offset)
-            {
-                loader_error(file);
-            }
-
             memset((void*)programHeader.virtAddr, 0, size);
-            if (vfs_read(file, (void*)programHeader.virtAddr, size) != size)
+            if (vfs_pread(file, (void*)programHeader.virtAddr, programHeader.fileSize, programHeader.offset) !=
+                programHeader.fileSize)
             {
                 loader_error(file);
             }
@@ -0,0 +1,163 @@
+#include "name_table.h"
+
+#include "sched.h"
+#include "vfs.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NAME_TABLE_MIN_CAPACITY 8
+
+// Removed slots keep probe chains intact until the next rehash.
+#define NAME_TABLE_TOMBSTONE ((void*)1)
+
+static name_slot_t* name_table_probe(const name_table_t* table, uint64_t hash, const char* name)
+{
+    uint64_t mask = table->capacity - 1;
+    for (uint64_t i = 0; i < table->capacity; i++)
+    {
+        name_slot_t* slot = &table->slots[(hash + i) & mask];
+        if (slot->node == NULL)
+        {
+            return NULL;
+        }
+
+        if (slot->node != NAME_TABLE_TOMBSTONE && slot->hash == hash && name_compare(slot->name, name))
+        {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+static void name_table_place(name_slot_t* slots, uint64_t capacity, uint64_t hash, const char* name, void* node)
+{
+    uint64_t mask = capacity - 1;
+    for (uint64_t i = 0; i < capacity; i++)
+    {
+        name_slot_t* slot = &slots[(hash + i) & mask];
+        if (slot->node == NULL || slot->node == NAME_TABLE_TOMBSTONE)
+        {
+            slot->hash = hash;
+            slot->name = name;
+            slot->node = node;
+            return;
+        }
+    }
+}
+
+static uint64_t name_table_rehash(name_table_t* table, uint64_t capacity)
+{
+    name_slot_t* slots = calloc(capacity, sizeof(name_slot_t));
+    if (slots == NULL)
+    {
+        return ERROR(ENOMEM);
+    }
+
+    for (uint64_t i = 0; i < table->capacity; i++)
+    {
+        name_slot_t* slot = &table->slots[i];
+        if (slot->node != NULL && slot->node != NAME_TABLE_TOMBSTONE)
+        {
+            name_table_place(slots, capacity, slot->hash, slot->name, slot->node);
+        }
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+    table->tombstones = 0;
+    return 0;
+}
+
+void name_table_init(name_table_t* table)
+{
+    table->slots = NULL;
+    table->capacity = 0;
+    table->amount = 0;
+    table->tombstones = 0;
+}
+
+void name_table_cleanup(name_table_t* table)
+{
+    free(table->slots);
+    name_table_init(table);
+}
+
+uint64_t name_table_insert(name_table_t* table, const char* name, void* node)
+{
+    // Keep the load factor including tombstones below 3/4, only grow if live entries are the problem.
+    if ((table->amount + table->tombstones + 1) * 4 > table->capacity * 3)
+    {
+        uint64_t capacity = table->capacity == 0 ? NAME_TABLE_MIN_CAPACITY : table->capacity;
+        while ((table->amount + 1) * 2 > capacity)
+        {
+            capacity *= 2;
+        }
+
+        if (name_table_rehash(table, capacity) == ERR)
+        {
+            return ERR;
+        }
+    }
+
+    uint64_t hash = name_hash(name);
+    if (name_table_probe(table, hash, name) != NULL)
+    {
+        return ERROR(EEXIST);
+    }
+
+    uint64_t mask = table->capacity - 1;
+    for (uint64_t i = 0; i < table->capacity; i++)
+    {
+        name_slot_t* slot = &table->slots[(hash + i) & mask];
+        if (slot->node == NULL || slot->node == NAME_TABLE_TOMBSTONE)
+        {
+            if (slot->node == NAME_TABLE_TOMBSTONE)
+            {
+                table->tombstones--;
+            }
+
+            slot->hash = hash;
+            slot->name = name;
+            slot->node = node;
+            table->amount++;
+            return 0;
+        }
+    }
+
+    return ERROR(ENOMEM);
+}
+
+void* name_table_find(const name_table_t* table, const char* name)
+{
+    if (table->amount == 0)
+    {
+        return NULL;
+    }
+
+    name_slot_t* slot = name_table_probe(table, name_hash(name), name);
+    return slot != NULL ? slot->node : NULL;
+}
+
+uint64_t name_table_remove(name_table_t* table, const char* name)
+{
+    if (table->amount == 0)
+    {
+        return ERROR(EPATH);
+    }
+
+    name_slot_t* slot = name_table_probe(table, name_hash(name), name);
+    if (slot == NULL)
+    {
+        return ERROR(EPATH);
+    }
+
+    slot->node = NAME_TABLE_TOMBSTONE;
+    slot->name = NULL;
+    table->amount--;
+    table->tombstones++;
+    return 0;
+}
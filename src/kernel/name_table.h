@@ -0,0 +1,31 @@
+#pragma once
+
+#include "defs.h"
+
+// Open addressing hash index from names to nodes, used by filesystems to index directory entries. The table does not
+// own the names, they must stay valid for as long as the node is in the table, usually by pointing into the node itself.
+
+typedef struct
+{
+    uint64_t hash;
+    const char* name;
+    void* node;
+} name_slot_t;
+
+typedef struct
+{
+    name_slot_t* slots;
+    uint64_t capacity;
+    uint64_t amount;
+    uint64_t tombstones;
+} name_table_t;
+
+void name_table_init(name_table_t* table);
+
+void name_table_cleanup(name_table_t* table);
+
+uint64_t name_table_insert(name_table_t* table, const char* name, void* node);
+
+void* name_table_find(const name_table_t* table, const char* name);
+
+uint64_t name_table_remove(name_table_t* table, const char* name);
@@ -103,6 +103,16 @@ void* pml_phys_addr(pml_t* table, const void* virtAddr)
     return (void*)(((uint64_t)PAGE_ENTRY_GET_ADDRESS(*entry)) + offset);
 }
 
+uint64_t pml_flags(pml_t* table, const void* virtAddr)
+{
+    pml_t* level3 = pml_get(table, PML_GET_INDEX(virtAddr, 4));
+    pml_t* level2 = pml_get(level3, PML_GET_INDEX(virtAddr, 3));
+    pml_t* level1 = pml_get(level2, PML_GET_INDEX(virtAddr, 2));
+    pml_entry_t entry = level1->entries[PML_GET_INDEX(virtAddr, 1)];
+
+    return entry & ~0x000FFFFFFFFFF000;
+}
+
 bool pml_mapped(pml_t* table, const void* virtAddr, uint64_t pageAmount)
 {
     for (uint64_t i = 0; i < pageAmount; i++)
@@ -41,6 +41,8 @@ void pml_load(pml_t* table);
 
 void* pml_phys_addr(pml_t* table, const void* virtAddr);
 
+uint64_t pml_flags(pml_t* table, const void* virtAddr);
+
 bool pml_mapped(pml_t* table, const void* virtAddr, uint64_t pageAmount);
 
 void pml_map(pml_t* table, void* virtAddr, void* physAddr, uint64_t pageAmount, uint64_t flags);
@@ -208,12 +208,17 @@ void pmm_init(efi_mem_map_t* memoryMap)
 
 void* pmm_alloc(void)
 {
-    LOCK_GUARD(&lock);
-    void* address = page_stack_alloc();
+    void* address = pmm_try_alloc();
     LOG_ASSERT(address != NULL, "no more memory");
     return address;
 }
 
+void* pmm_try_alloc(void)
+{
+    LOCK_GUARD(&lock);
+    return page_stack_alloc();
+}
+
 void* pmm_alloc_special(uint64_t count, uintptr_t maxAddr, uint64_t alignment)
 {
     LOCK_GUARD(&lock);
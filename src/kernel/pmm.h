@@ -32,6 +32,9 @@ void pmm_init(efi_mem_map_t* memoryMap);
 
 void* pmm_alloc(void);
 
+// Returns NULL instead of panicking when memory runs out, for allocations whose size a process controls.
+void* pmm_try_alloc(void);
+
 void* pmm_alloc_special(uint64_t count, uintptr_t maxAddr, uint64_t alignment);
 
 void pmm_free(void* address);
@@ -63,6 +63,7 @@ thread_t* thread_new(process_t* process, void* entry, uint8_t priority)
     thread->blocker = NULL;
     thread->error = 0;
     thread->priority = MIN(priority, THREAD_PRIORITY_MAX);
+    thread->affinity = THREAD_AFFINITY_NONE;
     simd_context_init(&thread->simdContext);
     memset(&thread->kernelStack, 0, CONFIG_KERNEL_STACK);
 
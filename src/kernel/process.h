@@ -16,6 +16,8 @@
 #define THREAD_PRIORITY_MIN 0
 #define THREAD_PRIORITY_MAX (THREAD_PRIORITY_LEVELS - 1)
 
+#define THREAD_AFFINITY_NONE (-1)
+
 typedef struct blocker blocker_t;
 
 typedef enum
@@ -55,6 +57,7 @@ typedef struct
     blocker_t* blocker;
     errno_t error;
     uint8_t priority;
+    int16_t affinity; // Id of the only cpu the thread may run on, or THREAD_AFFINITY_NONE.
     trap_frame_t trapFrame;
     simd_context_t simdContext;
     uint8_t kernelStack[CONFIG_KERNEL_STACK];
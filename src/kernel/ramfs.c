@@ -1,8 +1,10 @@
 #include "ramfs.h"
 
+#include "dcache.h"
 #include "log.h"
 #include "sched.h"
 #include "vfs.h"
+#include "vmm.h"
 
 #include <bootloader/boot_info.h>
 
@@ -11,39 +13,37 @@
 #include <sys/list.h>
 #include <sys/math.h>
 
-static ram_dir_t* root;
+static ramfs_dir_t* root;
 
-static ram_file_t* ram_dir_find_file(ram_dir_t* dir, const char* filename)
+static ramfs_file_t* ram_dir_find_file(ramfs_dir_t* dir, const char* filename)
 {
-    ram_file_t* file;
-    LIST_FOR_EACH(file, &dir->files)
+    void* cached;
+    if (dcache_lookup(dir, filename, STAT_FILE, &cached))
     {
-        if (name_compare(file->name, filename))
-        {
-            return file;
-        }
+        return cached;
     }
 
-    return NULL;
+    ramfs_file_t* file = name_table_find(&dir->fileTable, filename);
+    dcache_insert(dir, filename, STAT_FILE, file);
+    return file;
 }
 
-static ram_dir_t* ram_dir_find_dir(ram_dir_t* dir, const char* dirname)
+static ramfs_dir_t* ram_dir_find_dir(ramfs_dir_t* dir, const char* dirname)
 {
-    ram_dir_t* child;
-    LIST_FOR_EACH(child, &dir->children)
+    void* cached;
+    if (dcache_lookup(dir, dirname, STAT_DIR, &cached))
     {
-        if (name_compare(child->name, dirname))
-        {
-            return child;
-        }
+        return cached;
     }
 
-    return NULL;
+    ramfs_dir_t* child = name_table_find(&dir->childTable, dirname);
+    dcache_insert(dir, dirname, STAT_DIR, child);
+    return child;
 }
 
-static ram_dir_t* ramfs_traverse(const char* path)
+static ramfs_dir_t* ramfs_traverse(const char* path)
 {
-    ram_dir_t* dir = root;
+    ramfs_dir_t* dir = root;
     const char* dirname = name_first(path);
     while (dirname != NULL)
     {
@@ -59,9 +59,9 @@ static ram_dir_t* ramfs_traverse(const char* path)
     return dir;
 }
 
-static ram_dir_t* ramfs_traverse_parent(const char* path)
+static ramfs_dir_t* ramfs_traverse_parent(const char* path)
 {
-    ram_dir_t* dir = root;
+    ramfs_dir_t* dir = root;
     const char* dirname = dir_name_first(path);
     while (dirname != NULL)
     {
@@ -77,9 +77,9 @@ static ram_dir_t* ramfs_traverse_parent(const char* path)
     return dir;
 }
 
-static ram_file_t* ramfs_find_file(const char* path)
+static ramfs_file_t* ramfs_find_file(const char* path)
 {
-    ram_dir_t* parent = ramfs_traverse_parent(path);
+    ramfs_dir_t* parent = ramfs_traverse_parent(path);
     if (parent == NULL)
     {
         return NULL;
@@ -94,9 +94,9 @@ static ram_file_t* ramfs_find_file(const char* path)
     return ram_dir_find_file(parent, filename);
 }
 
-static ram_dir_t* ramfs_find_dir(const char* path)
+static ramfs_dir_t* ramfs_find_dir(const char* path)
 {
-    ram_dir_t* parent = ramfs_traverse_parent(path);
+    ramfs_dir_t* parent = ramfs_traverse_parent(path);
     if (parent == NULL)
     {
         return NULL;
@@ -111,12 +111,19 @@ static ram_dir_t* ramfs_find_dir(const char* path)
     return ram_dir_find_dir(parent, dirname);
 }
 
-static uint64_t ramfs_read(file_t* file, void* buffer, uint64_t count)
+static uint64_t ramfs_pread(file_t* file, void* buffer, uint64_t count, uint64_t offset)
 {
-    ram_file_t* private = file->private;
+    ramfs_file_t* private = file->private;
 
-    count = (file->pos <= private->size) ? MIN(count, private->size - file->pos) : 0;
-    memcpy(buffer, private->data + file->pos, count);
+    count = (offset <= private->size) ? MIN(count, private->size - offset) : 0;
+    memcpy(buffer, private->data + offset, count);
+
+    return count;
+}
+
+static uint64_t ramfs_read(file_t* file, void* buffer, uint64_t count)
+{
+    count = ramfs_pread(file, buffer, count, file->pos);
     file->pos += count;
 
     return count;
@@ -124,7 +131,7 @@ static uint64_t ramfs_read(file_t* file, void* buffer, uint64_t count)
 
 static uint64_t ramfs_seek(file_t* file, int64_t offset, seek_origin_t origin)
 {
-    ram_file_t* private = file->private;
+    ramfs_file_t* private = file->private;
 
     uint64_t position;
     switch (origin)
@@ -155,14 +162,45 @@ static uint64_t ramfs_seek(file_t* file, int64_t offset, seek_origin_t origin)
     return position;
 }
 
+static void* ramfs_mmap(file_t* file, void* address, uint64_t length, prot_t prot)
+{
+    ramfs_file_t* private = file->private;
+
+    if (length == 0 || SIZE_IN_PAGES(length) > SIZE_IN_PAGES(private->size))
+    {
+        return NULLPTR(EINVAL);
+    }
+
+    // File data is page aligned and never freed so read only mappings can share it, without a page fault handler writable
+    // mappings cant be copy on write and get an eager private copy instead. The shared pages are not owned by the mapping
+    // so vmm_protect() refuses to make them writable later.
+    if (!(prot & PROT_WRITE))
+    {
+        return vmm_map(address, VMM_HIGHER_TO_LOWER(private->data), length, prot);
+    }
+
+    address = vmm_alloc(address, length, prot);
+    if (address == NULL)
+    {
+        return NULL;
+    }
+
+    uint64_t copySize = MIN(length, private->size);
+    memcpy(address, private->data, copySize);
+    memset((uint8_t*)address + copySize, 0, ROUND_UP(length, PAGE_SIZE) - copySize);
+    return address;
+}
+
 static file_ops_t fileOps = {
     .read = ramfs_read,
     .seek = ramfs_seek,
+    .pread = ramfs_pread,
+    .mmap = ramfs_mmap,
 };
 
 static file_t* ramfs_open(volume_t* volume, const char* path)
 {
-    ram_file_t* ramFile = ramfs_find_file(path);
+    ramfs_file_t* ramFile = ramfs_find_file(path);
     if (ramFile == NULL)
     {
         return NULLPTR(EPATH);
@@ -179,7 +217,7 @@ static uint64_t ramfs_stat(volume_t* volume, const char* path, stat_t* buffer)
 {
     buffer->size = 0;
 
-    ram_dir_t* parent = ramfs_traverse_parent(path);
+    ramfs_dir_t* parent = ramfs_traverse_parent(path);
     if (parent == NULL)
     {
         return ERROR(EPATH);
@@ -204,7 +242,7 @@ static uint64_t ramfs_stat(volume_t* volume, const char* path, stat_t* buffer)
 
 static uint64_t ramfs_listdir(volume_t* volume, const char* path, dir_entry_t* entries, uint64_t amount)
 {
-    ram_dir_t* parent = ramfs_traverse(path);
+    ramfs_dir_t* parent = ramfs_traverse(path);
     if (parent == NULL)
     {
         return ERROR(EPATH);
@@ -213,7 +251,7 @@ static uint64_t ramfs_listdir(volume_t* volume, const char* path, dir_entry_t* e
     uint64_t index = 0;
     uint64_t total = 0;
 
-    ram_dir_t* dir;
+    ramfs_dir_t* dir;
     LIST_FOR_EACH(dir, &parent->children)
     {
         dir_entry_t entry = {0};
@@ -223,7 +261,7 @@ static uint64_t ramfs_listdir(volume_t* volume, const char* path, dir_entry_t* e
         dir_entry_push(entries, amount, &index, &total, &entry);
     }
 
-    ram_file_t* file;
+    ramfs_file_t* file;
     LIST_FOR_EACH(file, &parent->files)
     {
         dir_entry_t entry = {0};
@@ -252,31 +290,35 @@ static fs_t ramfs = {
     .mount = ramfs_mount,
 };
 
-static ram_dir_t* ramfs_load_dir(ram_dir_t* in)
+static ramfs_dir_t* ramfs_load_dir(ram_dir_t* in)
 {
-    ram_dir_t* out = malloc(sizeof(ram_dir_t));
+    ramfs_dir_t* out = malloc(sizeof(ramfs_dir_t));
     list_entry_init(&out->entry);
     strcpy(out->name, in->name);
     list_init(&out->children);
     list_init(&out->files);
+    name_table_init(&out->childTable);
+    name_table_init(&out->fileTable);
 
     ram_dir_t* child;
     LIST_FOR_EACH(child, &in->children)
     {
-        list_push(&out->children, ramfs_load_dir(child));
+        ramfs_dir_t* outChild = ramfs_load_dir(child);
+        list_push(&out->children, outChild);
+        LOG_ASSERT(name_table_insert(&out->childTable, outChild->name, outChild) != ERR, "dir index fail");
     }
 
     ram_file_t* inFile;
     LIST_FOR_EACH(inFile, &in->files)
     {
-        ram_file_t* outFile = malloc(sizeof(ram_file_t));
+        ramfs_file_t* outFile = malloc(sizeof(ramfs_file_t));
         list_entry_init(&outFile->entry);
         strcpy(outFile->name, inFile->name);
         outFile->size = inFile->size;
-        outFile->data = malloc(outFile->size);
-        memcpy(outFile->data, inFile->data, outFile->size);
+        outFile->data = inFile->data; // Page aligned EFI_RAM_DISK_DATA, never freed.
 
         list_push(&out->files, outFile);
+        LOG_ASSERT(name_table_insert(&out->fileTable, outFile->name, outFile) != ERR, "file index fail");
     }
 
     return out;
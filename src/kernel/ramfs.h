@@ -1,5 +1,27 @@
 #pragma once
 
 #include <bootloader/boot_info.h>
+#include <sys/io.h>
+#include <sys/list.h>
+
+#include "name_table.h"
+
+typedef struct
+{
+    list_entry_t entry;
+    char name[MAX_NAME];
+    void* data;
+    uint64_t size;
+} ramfs_file_t;
+
+typedef struct
+{
+    list_entry_t entry;
+    char name[MAX_NAME];
+    list_t children;
+    list_t files;
+    name_table_t childTable;
+    name_table_t fileTable;
+} ramfs_dir_t;
 
 void ramfs_init(ram_dir_t* ramRoot);
@@ -0,0 +1,196 @@
+#include "ring.h"
+
+#include "log.h"
+#include "sched.h"
+#include "syscall.h"
+#include "sysfs.h"
+#include "vfs.h"
+#include "vmm.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Submissions are executed through the same handlers as the syscalls, so pointer verification and fd lookup are identical,
+// the only thing saved is the trap and the scheduler invocation per operation.
+static uint64_t ring_dispatch(const ring_sqe_t* sqe)
+{
+    switch (sqe->op)
+    {
+    case RING_OP_NOP:
+    {
+        return 0;
+    }
+    case RING_OP_READ:
+    {
+        return syscall_read(sqe->fd, (void*)sqe->args[0], sqe->args[1]);
+    }
+    case RING_OP_WRITE:
+    {
+        return syscall_write(sqe->fd, (const void*)sqe->args[0], sqe->args[1]);
+    }
+    case RING_OP_SEEK:
+    {
+        return syscall_seek(sqe->fd, (int64_t)sqe->args[0], (seek_origin_t)sqe->args[1]);
+    }
+    case RING_OP_IOCTL:
+    {
+        return syscall_ioctl(sqe->fd, sqe->args[0], (void*)sqe->args[1], sqe->args[2]);
+    }
+    case RING_OP_FLUSH:
+    {
+        return syscall_flush(sqe->fd, (const pixel_t*)sqe->args[0], sqe->args[1], (const rect_t*)sqe->args[2]);
+    }
+    case RING_OP_CLOSE:
+    {
+        return syscall_close(sqe->fd);
+    }
+    case RING_OP_PREAD:
+    {
+        return syscall_pread(sqe->fd, (void*)sqe->args[0], sqe->args[1], sqe->args[2]);
+    }
+    case RING_OP_PWRITE:
+    {
+        return syscall_pwrite(sqe->fd, (const void*)sqe->args[0], sqe->args[1], sqe->args[2]);
+    }
+    default:
+    {
+        return ERROR(EINVAL);
+    }
+    }
+}
+
+static uint64_t ring_enter(ring_context_t* context, uint64_t amount)
+{
+    ring_t* ring = context->ring;
+    if (!vmm_mapped(ring, sizeof(ring_t)))
+    {
+        return ERROR(EFAULT);
+    }
+
+    uint64_t completed = 0;
+    while (completed < amount)
+    {
+        uint32_t sqHead = atomic_load(&ring->sqHead);
+        uint32_t cqTail = atomic_load(&ring->cqTail);
+        if (sqHead == atomic_load(&ring->sqTail) || cqTail - atomic_load(&ring->cqHead) >= RING_CQ_MAX)
+        {
+            break;
+        }
+
+        // Copy the entry first, the process could modify it while we are executing it.
+        ring_sqe_t sqe = ring->sq[RING_SQ_INDEX(sqHead)];
+        atomic_store(&ring->sqHead, sqHead + 1);
+
+        uint64_t result = ring_dispatch(&sqe);
+
+        ring_cqe_t* cqe = &ring->cq[RING_CQ_INDEX(cqTail)];
+        cqe->userData = sqe.userData;
+        cqe->result = result;
+        cqe->error = result == ERR ? sched_thread()->error : 0;
+        atomic_store(&ring->cqTail, cqTail + 1);
+
+        completed++;
+    }
+
+    return completed;
+}
+
+static uint64_t ring_ioctl(file_t* file, uint64_t request, void* argp, uint64_t size)
+{
+    ring_context_t* context = file->private;
+
+    switch (request)
+    {
+    case IOCTL_RING_ENTER:
+    {
+        if (size != sizeof(ioctl_ring_enter_t))
+        {
+            return ERROR(EINVAL);
+        }
+        ioctl_ring_enter_t* enter = argp;
+
+        if (context->ring == NULL)
+        {
+            return ERROR(EFAULT);
+        }
+
+        // A submission could itself be an enter on this ring.
+        if (atomic_exchange(&context->entered, true))
+        {
+            return ERROR(EBUSY);
+        }
+
+        uint64_t result = ring_enter(context, enter->amount);
+        atomic_store(&context->entered, false);
+        if (result == ERR)
+        {
+            return ERR;
+        }
+
+        enter->outCompleted = result;
+        return 0;
+    }
+    default:
+    {
+        return ERROR(EREQ);
+    }
+    }
+}
+
+static void* ring_mmap(file_t* file, void* address, uint64_t length, prot_t prot)
+{
+    ring_context_t* context = file->private;
+
+    if (context->ring != NULL)
+    {
+        return NULLPTR(EBUSY);
+    }
+
+    if (length < sizeof(ring_t) || !(prot & PROT_WRITE))
+    {
+        return NULLPTR(EINVAL);
+    }
+
+    ring_t* ring = vmm_alloc(address, sizeof(ring_t), prot);
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    memset(ring, 0, sizeof(ring_t));
+
+    context->ring = ring;
+    return ring;
+}
+
+static void ring_cleanup(file_t* file)
+{
+    free(file->private);
+}
+
+static file_ops_t fileOps = {
+    .ioctl = ring_ioctl,
+    .mmap = ring_mmap,
+    .cleanup = ring_cleanup,
+};
+
+static uint64_t ring_open(resource_t* resource, file_t* file)
+{
+    ring_context_t* context = malloc(sizeof(ring_context_t));
+    if (context == NULL)
+    {
+        return ERROR(ENOMEM);
+    }
+    context->ring = NULL;
+    atomic_init(&context->entered, false);
+
+    file->private = context;
+    return 0;
+}
+
+void ring_init(void)
+{
+    sysfs_expose("/", "ring", &fileOps, NULL, ring_open, NULL);
+
+    log_print("ring: init");
+}
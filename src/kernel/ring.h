@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <sys/ring.h>
+
+#include "defs.h"
+
+typedef struct
+{
+    ring_t* ring; // User space address, only valid within the owning process.
+    atomic_bool entered;
+} ring_context_t;
+
+void ring_init(void);
@@ -131,6 +131,12 @@ static thread_t* sched_context_find_any(sched_context_t* context)
 
 static void sched_push(thread_t* thread)
 {
+    if (thread->affinity != THREAD_AFFINITY_NONE)
+    {
+        sched_context_push(&smp_cpu(thread->affinity)->sched, thread);
+        return;
+    }
+
     int64_t bestLength = INT64_MAX;
     cpu_t* best = NULL;
     for (uint64_t i = 0; i < smp_cpu_amount(); i++)
@@ -333,6 +339,15 @@ tid_t sched_thread_spawn(void* entry, uint8_t priority)
     return thread->id;
 }
 
+tid_t sched_thread_spawn_on(void* entry, uint8_t priority, uint8_t cpu)
+{
+    thread_t* thread = thread_new(sched_process(), entry, priority);
+    thread->affinity = cpu;
+    sched_push(thread);
+
+    return thread->id;
+}
+
 static void sched_update_blockers(void)
 {
     LOCK_GUARD(&blockersLock);
@@ -147,4 +147,7 @@ pid_t sched_spawn(const char* path, uint8_t priority);
 
 tid_t sched_thread_spawn(void* entry, uint8_t priority);
 
+// Spawns a thread that is only ever scheduled on the given cpu, also after it blocks.
+tid_t sched_thread_spawn_on(void* entry, uint8_t priority, uint8_t cpu);
+
 void sched_schedule(trap_frame_t* trapFrame);
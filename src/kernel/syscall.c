@@ -293,7 +293,8 @@ uint64_t syscall_mprotect(void* address, uint64_t length, prot_t prot)
 
 uint64_t syscall_flush(fd_t fd, const pixel_t* buffer, uint64_t size, const rect_t* rect)
 {
-    if (!verify_buffer(buffer, size))
+    // A NULL buffer only reports damage to a surface the caller has mapped.
+    if ((buffer != NULL || size != 0) && !verify_buffer(buffer, size))
     {
         return ERROR(EFAULT);
     }
@@ -323,6 +324,132 @@ uint64_t syscall_listdir(const char* path, dir_entry_t* entries, uint64_t amount
     return vfs_listdir(path, entries, amount);
 }
 
+uint64_t syscall_create(const char* path)
+{
+    if (!verify_string(path))
+    {
+        return ERROR(EFAULT);
+    }
+
+    return vfs_create(path);
+}
+
+uint64_t syscall_unlink(const char* path)
+{
+    if (!verify_string(path))
+    {
+        return ERROR(EFAULT);
+    }
+
+    return vfs_unlink(path);
+}
+
+uint64_t syscall_truncate(fd_t fd, uint64_t length)
+{
+    file_t* file = vfs_context_get(&sched_process()->vfsContext, fd);
+    if (file == NULL)
+    {
+        return ERR;
+    }
+    FILE_GUARD(file);
+
+    return vfs_truncate(file, length);
+}
+
+static uint64_t copy_iovec(iovec_t* dest, const iovec_t* iov, uint64_t amount)
+{
+    if (amount > IOV_MAX)
+    {
+        return ERROR(EINVAL);
+    }
+
+    if (!verify_buffer(iov, sizeof(iovec_t) * amount))
+    {
+        return ERROR(EFAULT);
+    }
+
+    memcpy(dest, iov, sizeof(iovec_t) * amount);
+    for (uint64_t i = 0; i < amount; i++)
+    {
+        if (!verify_buffer(dest[i].base, dest[i].length))
+        {
+            return ERROR(EFAULT);
+        }
+    }
+
+    return 0;
+}
+
+uint64_t syscall_readv(fd_t fd, const iovec_t* iov, uint64_t amount)
+{
+    iovec_t buffers[IOV_MAX];
+    if (copy_iovec(buffers, iov, amount) == ERR)
+    {
+        return ERR;
+    }
+
+    file_t* file = vfs_context_get(&sched_process()->vfsContext, fd);
+    if (file == NULL)
+    {
+        return ERR;
+    }
+    FILE_GUARD(file);
+
+    return vfs_readv(file, buffers, amount);
+}
+
+uint64_t syscall_writev(fd_t fd, const iovec_t* iov, uint64_t amount)
+{
+    iovec_t buffers[IOV_MAX];
+    if (copy_iovec(buffers, iov, amount) == ERR)
+    {
+        return ERR;
+    }
+
+    file_t* file = vfs_context_get(&sched_process()->vfsContext, fd);
+    if (file == NULL)
+    {
+        return ERR;
+    }
+    FILE_GUARD(file);
+
+    return vfs_writev(file, buffers, amount);
+}
+
+uint64_t syscall_pread(fd_t fd, void* buffer, uint64_t count, uint64_t offset)
+{
+    if (!verify_buffer(buffer, count))
+    {
+        return ERROR(EFAULT);
+    }
+
+    file_t* file = vfs_context_get(&sched_process()->vfsContext, fd);
+    if (file == NULL)
+    {
+        return ERR;
+    }
+    FILE_GUARD(file);
+
+    return vfs_pread(file, buffer, count, offset);
+}
+
+uint64_t syscall_pwrite(fd_t fd, const void* buffer, uint64_t count, uint64_t offset)
+{
+    if (!verify_buffer(buffer, count))
+    {
+        return ERROR(EFAULT);
+    }
+
+    file_t* file = vfs_context_get(&sched_process()->vfsContext, fd);
+    if (file == NULL)
+    {
+        return ERR;
+    }
+    FILE_GUARD(file);
+
+    return vfs_pwrite(file, buffer, count, offset);
+}
+
 ///////////////////////////////////////////////////////
 
 void syscall_handler_end(void)
@@ -359,4 +486,11 @@ void* syscallTable[] = {
     syscall_mprotect,
     syscall_flush,
     syscall_listdir,
+    syscall_readv,
+    syscall_writev,
+    syscall_pread,
+    syscall_pwrite,
+    syscall_create,
+    syscall_unlink,
+    syscall_truncate,
 };
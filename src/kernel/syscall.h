@@ -1,9 +1,33 @@
 #pragma once
 
+#include <sys/io.h>
+
+#include "defs.h"
+
 #define SYSCALL_VECTOR 0x80
 
 extern void* syscallTable[];
 
 extern void syscall_handler(void);
 
-void syscall_handler_end(void);
\ No newline at end of file
+void syscall_handler_end(void);
+
+uint64_t syscall_close(fd_t fd);
+
+uint64_t syscall_read(fd_t fd, void* buffer, uint64_t count);
+
+uint64_t syscall_write(fd_t fd, const void* buffer, uint64_t count);
+
+uint64_t syscall_readv(fd_t fd, const iovec_t* iov, uint64_t amount);
+
+uint64_t syscall_writev(fd_t fd, const iovec_t* iov, uint64_t amount);
+
+uint64_t syscall_pread(fd_t fd, void* buffer, uint64_t count, uint64_t offset);
+
+uint64_t syscall_pwrite(fd_t fd, const void* buffer, uint64_t count, uint64_t offset);
+
+uint64_t syscall_seek(fd_t fd, int64_t offset, seek_origin_t origin);
+
+uint64_t syscall_ioctl(fd_t fd, uint64_t request, void* argp, uint64_t size);
+
+uint64_t syscall_flush(fd_t fd, const pixel_t* buffer, uint64_t size, const rect_t* rect);
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "sysfs.h"
 
+#include "dcache.h"
 #include "lock.h"
 #include "log.h"
 #include "sched.h"
@@ -21,36 +22,36 @@ static system_t* system_new(const char* name)
     name_copy(system->name, name);
     list_init(&system->resources);
     list_init(&system->systems);
+    name_table_init(&system->resourceTable);
+    name_table_init(&system->systemTable);
 
     return system;
 }
 
 static system_t* system_find_system(system_t* parent, const char* name)
 {
-    system_t* system;
-    LIST_FOR_EACH(system, &parent->systems)
+    void* cached;
+    if (dcache_lookup(parent, name, STAT_DIR, &cached))
     {
-        if (name_compare(system->name, name))
-        {
-            return system;
-        }
+        return cached;
     }
 
-    return NULL;
+    system_t* system = name_table_find(&parent->systemTable, name);
+    dcache_insert(parent, name, STAT_DIR, system);
+    return system;
 }
 
 static resource_t* system_find_resource(system_t* parent, const char* name)
 {
-    resource_t* resource;
-    LIST_FOR_EACH(resource, &parent->resources)
+    void* cached;
+    if (dcache_lookup(parent, name, STAT_RES, &cached))
     {
-        if (name_compare(resource->name, name))
-        {
-            return resource;
-        }
+        return cached;
     }
 
-    return NULL;
+    resource_t* resource = name_table_find(&parent->resourceTable, name);
+    dcache_insert(parent, name, STAT_RES, resource);
+    return resource;
 }
 
 static void resource_free(resource_t* resource)
@@ -340,7 +341,13 @@ resource_t* sysfs_expose(const char* path, const char* filename, const file_ops_
         if (child == NULL)
         {
             child = system_new(name);
+            if (name_table_insert(&system->systemTable, child->name, child) == ERR)
+            {
+                free(child);
+                return NULL;
+            }
             list_push(&system->systems, child);
+            dcache_invalidate(system, name, STAT_DIR);
         }
 
         system = child;
@@ -358,7 +365,13 @@ resource_t* sysfs_expose(const char* path, const char* filename, const file_ops_
     atomic_init(&resource->ref, 1);
     atomic_init(&resource->hidden, false);
 
+    if (name_table_insert(&system->resourceTable, resource->name, resource) == ERR)
+    {
+        free(resource);
+        return NULL;
+    }
     list_push(&system->resources, resource);
+    dcache_invalidate(system, filename, STAT_RES);
     return resource;
 }
 
@@ -366,6 +379,8 @@ uint64_t sysfs_hide(resource_t* resource)
 {
     lock_acquire(&lock);
     list_remove(resource);
+    name_table_remove(&resource->system->resourceTable, resource->name);
+    dcache_invalidate(resource->system, resource->name, STAT_RES);
     lock_release(&lock);
 
     atomic_store(&resource->hidden, true);
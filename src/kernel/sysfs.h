@@ -4,6 +4,7 @@
 #include <sys/list.h>
 
 #include "defs.h"
+#include "name_table.h"
 #include "vfs.h"
 
 typedef struct system
@@ -12,6 +13,8 @@ typedef struct system
     char name[MAX_NAME];
     list_t resources;
     list_t systems;
+    name_table_t resourceTable;
+    name_table_t systemTable;
 } system_t;
 
 typedef uint64_t (*resource_open_t)(resource_t*, file_t*);
@@ -0,0 +1,568 @@
+#include "tmpfs.h"
+
+#include "config.h"
+#include "log.h"
+#include "name_table.h"
+#include "pmm.h"
+#include "sched.h"
+#include "vfs.h"
+#include "vmm.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/math.h>
+
+static list_t files;
+static name_table_t table;
+static lock_t lock;
+
+// Data pages and tree nodes held by all files, a process controls how much of it is used so it is limited and allocations
+// fail with an error instead of exhausting physical memory.
+static atomic_uint64_t usedPages;
+
+static uint64_t tmpfs_capacity(uint64_t height)
+{
+    return height == 0 ? 0 : 1ULL << (TMPFS_NODE_SHIFT * height);
+}
+
+static void* tmpfs_page_alloc(void)
+{
+    if (atomic_fetch_add(&usedPages, 1) >= CONFIG_TMPFS_MAX_PAGES)
+    {
+        atomic_fetch_sub(&usedPages, 1);
+        return NULL;
+    }
+
+    void* page = pmm_try_alloc();
+    if (page == NULL)
+    {
+        atomic_fetch_sub(&usedPages, 1);
+        return NULL;
+    }
+
+    memset(page, 0, PAGE_SIZE);
+    return page;
+}
+
+static void tmpfs_page_free(void* page)
+{
+    pmm_free(page);
+    atomic_fetch_sub(&usedPages, 1);
+}
+
+static void tmpfs_node_free(tmpfs_node_t* node, uint64_t level, bool freePages)
+{
+    for (uint64_t i = 0; i < TMPFS_NODE_SLOTS; i++)
+    {
+        if (node->slots[i] == NULL)
+        {
+            continue;
+        }
+
+        if (level > 1)
+        {
+            tmpfs_node_free(node->slots[i], level - 1, freePages);
+        }
+        else if (freePages)
+        {
+            tmpfs_page_free(node->slots[i]);
+        }
+    }
+
+    tmpfs_page_free(node);
+}
+
+static void** tmpfs_slot(tmpfs_file_t* tmpFile, uint64_t index, bool create)
+{
+    while (index >= tmpfs_capacity(tmpFile->height))
+    {
+        if (!create || tmpFile->height == TMPFS_MAX_HEIGHT)
+        {
+            return NULL;
+        }
+
+        tmpfs_node_t* node = tmpfs_page_alloc();
+        if (node == NULL)
+        {
+            return NULL;
+        }
+        node->slots[0] = tmpFile->root;
+        tmpFile->root = node;
+        tmpFile->height++;
+    }
+
+    tmpfs_node_t* node = tmpFile->root;
+    for (uint64_t level = tmpFile->height - 1; level > 0; level--)
+    {
+        void** slot = &node->slots[(index >> (TMPFS_NODE_SHIFT * level)) % TMPFS_NODE_SLOTS];
+        if (*slot == NULL)
+        {
+            if (!create)
+            {
+                return NULL;
+            }
+            *slot = tmpfs_page_alloc();
+            if (*slot == NULL)
+            {
+                return NULL;
+            }
+        }
+
+        node = *slot;
+    }
+
+    return &node->slots[index % TMPFS_NODE_SLOTS];
+}
+
+// Returns the higher half address of a page, pages that were never written are holes and read as zero. Fails if a page
+// has to be created and the limit or physical memory is exhausted.
+static void* tmpfs_page(tmpfs_file_t* tmpFile, uint64_t index, bool create)
+{
+    void** slot = tmpfs_slot(tmpFile, index, create);
+    if (slot == NULL)
+    {
+        return NULL;
+    }
+
+    if (*slot == NULL && create)
+    {
+        *slot = tmpfs_page_alloc();
+    }
+
+    return *slot;
+}
+
+static tmpfs_file_t* tmpfs_file_ref(tmpfs_file_t* tmpFile)
+{
+    atomic_fetch_add(&tmpFile->ref, 1);
+    return tmpFile;
+}
+
+static void tmpfs_file_deref(tmpfs_file_t* tmpFile)
+{
+    if (atomic_fetch_sub(&tmpFile->ref, 1) > 1)
+    {
+        return;
+    }
+
+    // Without page reference counting we cant know when a mapping goes away, so pages that have been mapped are kept.
+    if (tmpFile->root != NULL)
+    {
+        tmpfs_node_free(tmpFile->root, tmpFile->height, !tmpFile->mapped);
+    }
+    free(tmpFile);
+}
+
+static const char* tmpfs_name(const char* path)
+{
+    const char* name = name_first(path);
+    if (name == NULL || name_next(name) != NULL)
+    {
+        return NULL;
+    }
+
+    return name;
+}
+
+static uint64_t tmpfs_pread(file_t* file, void* buffer, uint64_t count, uint64_t offset)
+{
+    tmpfs_file_t* tmpFile = file->private;
+    LOCK_GUARD(&tmpFile->lock);
+
+    count = (offset <= tmpFile->size) ? MIN(count, tmpFile->size - offset) : 0;
+
+    uint64_t done = 0;
+    while (done < count)
+    {
+        uint64_t pos = offset + done;
+        uint64_t pageOffset = pos % PAGE_SIZE;
+        uint64_t chunk = MIN(PAGE_SIZE - pageOffset, count - done);
+
+        void* page = tmpfs_page(tmpFile, pos / PAGE_SIZE, false);
+        if (page == NULL)
+        {
+            memset((uint8_t*)buffer + done, 0, chunk);
+        }
+        else
+        {
+            memcpy((uint8_t*)buffer + done, (uint8_t*)page + pageOffset, chunk);
+        }
+
+        done += chunk;
+    }
+
+    return count;
+}
+
+static uint64_t tmpfs_pwrite(file_t* file, const void* buffer, uint64_t count, uint64_t offset)
+{
+    tmpfs_file_t* tmpFile = file->private;
+    LOCK_GUARD(&tmpFile->lock);
+
+    if (offset >= CONFIG_TMPFS_MAX_PAGES * PAGE_SIZE)
+    {
+        return ERROR(ENOSPC);
+    }
+    count = MIN(count, CONFIG_TMPFS_MAX_PAGES * PAGE_SIZE - offset);
+
+    uint64_t done = 0;
+    while (done < count)
+    {
+        uint64_t pos = offset + done;
+        uint64_t pageOffset = pos % PAGE_SIZE;
+        uint64_t chunk = MIN(PAGE_SIZE - pageOffset, count - done);
+
+        void* page = tmpfs_page(tmpFile, pos / PAGE_SIZE, true);
+        if (page == NULL)
+        {
+            break;
+        }
+
+        memcpy((uint8_t*)page + pageOffset, (const uint8_t*)buffer + done, chunk);
+        done += chunk;
+    }
+
+    if (done == 0 && count != 0)
+    {
+        return ERROR(ENOSPC);
+    }
+
+    tmpFile->size = MAX(tmpFile->size, offset + done);
+    return done;
+}
+
+static uint64_t tmpfs_read(file_t* file, void* buffer, uint64_t count)
+{
+    count = tmpfs_pread(file, buffer, count, file->pos);
+    file->pos += count;
+
+    return count;
+}
+
+static uint64_t tmpfs_write(file_t* file, const void* buffer, uint64_t count)
+{
+    count = tmpfs_pwrite(file, buffer, count, file->pos);
+    if (count == ERR)
+    {
+        return ERR;
+    }
+    file->pos += count;
+
+    return count;
+}
+
+static uint64_t tmpfs_seek(file_t* file, int64_t offset, seek_origin_t origin)
+{
+    tmpfs_file_t* tmpFile = file->private;
+    LOCK_GUARD(&tmpFile->lock);
+
+    uint64_t position;
+    switch (origin)
+    {
+    case SEEK_SET:
+    {
+        position = offset;
+    }
+    break;
+    case SEEK_CUR:
+    {
+        position = file->pos + offset;
+    }
+    break;
+    case SEEK_END:
+    {
+        position = tmpFile->size - offset;
+    }
+    break;
+    default:
+    {
+        position = 0;
+    }
+    break;
+    }
+
+    file->pos = MIN(position, tmpFile->size);
+    return position;
+}
+
+static uint64_t tmpfs_truncate(file_t* file, uint64_t length)
+{
+    tmpfs_file_t* tmpFile = file->private;
+    LOCK_GUARD(&tmpFile->lock);
+
+    if (length < tmpFile->size)
+    {
+        if (tmpFile->mapped)
+        {
+            return ERROR(EBUSY);
+        }
+
+        for (uint64_t i = SIZE_IN_PAGES(length); i < SIZE_IN_PAGES(tmpFile->size); i++)
+        {
+            void** slot = tmpfs_slot(tmpFile, i, false);
+            if (slot != NULL && *slot != NULL)
+            {
+                tmpfs_page_free(*slot);
+                *slot = NULL;
+            }
+        }
+
+        // The tail of the last page must read as zero if the file grows again.
+        void* page = length % PAGE_SIZE != 0 ? tmpfs_page(tmpFile, length / PAGE_SIZE, false) : NULL;
+        if (page != NULL)
+        {
+            memset((uint8_t*)page + length % PAGE_SIZE, 0, PAGE_SIZE - length % PAGE_SIZE);
+        }
+    }
+    else if (SIZE_IN_PAGES(length) > CONFIG_TMPFS_MAX_PAGES)
+    {
+        return ERROR(ENOSPC);
+    }
+
+    tmpFile->size = length;
+    file->pos = MIN(file->pos, length);
+    return 0;
+}
+
+static void* tmpfs_mmap(file_t* file, void* address, uint64_t length, prot_t prot)
+{
+    tmpfs_file_t* tmpFile = file->private;
+    LOCK_GUARD(&tmpFile->lock);
+
+    uint64_t pageAmount = SIZE_IN_PAGES(length);
+    if (pageAmount == 0 || pageAmount > SIZE_IN_PAGES(tmpFile->size))
+    {
+        return NULLPTR(EINVAL);
+    }
+
+    void** pages = malloc(sizeof(void*) * pageAmount);
+    if (pages == NULL)
+    {
+        return NULLPTR(ENOMEM);
+    }
+
+    // Holes are filled in so that every mapped page is backed, the holes are remembered as NULL entries so that the pages
+    // created for them can be released again if the file runs out of space part way through.
+    for (uint64_t i = 0; i < pageAmount; i++)
+    {
+        pages[i] = tmpfs_page(tmpFile, i, false);
+    }
+
+    for (uint64_t i = 0; i < pageAmount; i++)
+    {
+        if (pages[i] != NULL || tmpfs_page(tmpFile, i, true) != NULL)
+        {
+            continue;
+        }
+
+        for (uint64_t j = 0; j < i; j++)
+        {
+            void** slot = pages[j] == NULL ? tmpfs_slot(tmpFile, j, false) : NULL;
+            if (slot != NULL && *slot != NULL)
+            {
+                tmpfs_page_free(*slot);
+                *slot = NULL;
+            }
+        }
+
+        free(pages);
+        return NULLPTR(ENOSPC);
+    }
+
+    for (uint64_t i = 0; i < pageAmount; i++)
+    {
+        pages[i] = VMM_HIGHER_TO_LOWER(tmpfs_page(tmpFile, i, false));
+    }
+
+    address = vmm_map_pages(address, pages, pageAmount, prot);
+    free(pages);
+    if (address == NULL)
+    {
+        return NULL;
+    }
+
+    tmpFile->mapped = true;
+    return address;
+}
+
+static void tmpfs_cleanup(file_t* file)
+{
+    tmpfs_file_deref(file->private);
+}
+
+static file_ops_t fileOps = {
+    .read = tmpfs_read,
+    .write = tmpfs_write,
+    .seek = tmpfs_seek,
+    .pread = tmpfs_pread,
+    .pwrite = tmpfs_pwrite,
+    .truncate = tmpfs_truncate,
+    .mmap = tmpfs_mmap,
+    .cleanup = tmpfs_cleanup,
+};
+
+static file_t* tmpfs_open(volume_t* volume, const char* path)
+{
+    const char* name = tmpfs_name(path);
+    if (name == NULL)
+    {
+        return NULLPTR(EPATH);
+    }
+    LOCK_GUARD(&lock);
+
+    tmpfs_file_t* tmpFile = name_table_find(&table, name);
+    if (tmpFile == NULL)
+    {
+        return NULLPTR(EPATH);
+    }
+
+    file_t* file = file_new(volume);
+    file->ops = &fileOps;
+    file->private = tmpfs_file_ref(tmpFile);
+
+    return file;
+}
+
+static uint64_t tmpfs_stat(volume_t* volume, const char* path, stat_t* buffer)
+{
+    buffer->size = 0;
+
+    if (name_first(path) == NULL)
+    {
+        buffer->type = STAT_DIR;
+        return 0;
+    }
+
+    const char* name = tmpfs_name(path);
+    if (name == NULL)
+    {
+        return ERROR(EPATH);
+    }
+    LOCK_GUARD(&lock);
+
+    tmpfs_file_t* tmpFile = name_table_find(&table, name);
+    if (tmpFile == NULL)
+    {
+        return ERROR(EPATH);
+    }
+
+    buffer->type = STAT_FILE;
+    buffer->size = tmpFile->size;
+    return 0;
+}
+
+static uint64_t tmpfs_listdir(volume_t* volume, const char* path, dir_entry_t* entries, uint64_t amount)
+{
+    if (name_first(path) != NULL)
+    {
+        return ERROR(EPATH);
+    }
+    LOCK_GUARD(&lock);
+
+    uint64_t index = 0;
+    uint64_t total = 0;
+
+    tmpfs_file_t* tmpFile;
+    LIST_FOR_EACH(tmpFile, &files)
+    {
+        dir_entry_t entry = {0};
+        strcpy(entry.name, tmpFile->name);
+        entry.type = STAT_FILE;
+
+        dir_entry_push(entries, amount, &index, &total, &entry);
+    }
+
+    return total;
+}
+
+static uint64_t tmpfs_create(volume_t* volume, const char* path)
+{
+    const char* name = tmpfs_name(path);
+    if (name == NULL || name_length(name) >= MAX_NAME || !name_valid(name))
+    {
+        return ERROR(EPATH);
+    }
+    LOCK_GUARD(&lock);
+
+    if (name_table_find(&table, name) != NULL)
+    {
+        return ERROR(EEXIST);
+    }
+
+    tmpfs_file_t* tmpFile = malloc(sizeof(tmpfs_file_t));
+    if (tmpFile == NULL)
+    {
+        return ERROR(ENOMEM);
+    }
+    list_entry_init(&tmpFile->entry);
+    name_copy(tmpFile->name, name);
+    tmpFile->size = 0;
+    tmpFile->root = NULL;
+    tmpFile->height = 0;
+    tmpFile->mapped = false;
+    atomic_init(&tmpFile->ref, 1);
+    lock_init(&tmpFile->lock);
+
+    if (name_table_insert(&table, tmpFile->name, tmpFile) == ERR)
+    {
+        free(tmpFile);
+        return ERR;
+    }
+    list_push(&files, tmpFile);
+
+    return 0;
+}
+
+static uint64_t tmpfs_unlink(volume_t* volume, const char* path)
+{
+    const char* name = tmpfs_name(path);
+    if (name == NULL)
+    {
+        return ERROR(EPATH);
+    }
+    LOCK_GUARD(&lock);
+
+    tmpfs_file_t* tmpFile = name_table_find(&table, name);
+    if (tmpFile == NULL)
+    {
+        return ERROR(EPATH);
+    }
+
+    name_table_remove(&table, tmpFile->name);
+    list_remove(tmpFile);
+
+    // Open files keep their own reference, the data lives until the last one is closed.
+    tmpfs_file_deref(tmpFile);
+    return 0;
+}
+
+static volume_ops_t volumeOps = {
+    .open = tmpfs_open,
+    .stat = tmpfs_stat,
+    .listdir = tmpfs_listdir,
+    .create = tmpfs_create,
+    .unlink = tmpfs_unlink,
+};
+
+static uint64_t tmpfs_mount(const char* label)
+{
+    return vfs_attach_simple(label, &volumeOps);
+}
+
+static fs_t tmpfs = {
+    .name = "tmpfs",
+    .mount = tmpfs_mount,
+};
+
+void tmpfs_init(void)
+{
+    list_init(&files);
+    name_table_init(&table);
+    lock_init(&lock);
+    atomic_init(&usedPages, 0);
+
+    LOG_ASSERT(vfs_mount("tmp", &tmpfs) != ERR, "mount fail");
+
+    log_print("tmpfs: initialized");
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <sys/io.h>
+#include <sys/list.h>
+#include <sys/proc.h>
+
+#include "defs.h"
+#include "lock.h"
+
+#define TMPFS_NODE_SLOTS (PAGE_SIZE / sizeof(void*))
+#define TMPFS_NODE_SHIFT 9
+#define TMPFS_MAX_HEIGHT 4
+
+// Radix tree node, interior nodes point to nodes and leaves point to data pages, both are single pages.
+typedef struct
+{
+    void* slots[TMPFS_NODE_SLOTS];
+} tmpfs_node_t;
+
+typedef struct
+{
+    list_entry_t entry;
+    char name[MAX_NAME];
+    uint64_t size;
+    tmpfs_node_t* root;
+    uint64_t height;
+    bool mapped;
+    atomic_uint64_t ref;
+    lock_t lock;
+} tmpfs_file_t;
+
+void tmpfs_init(void);
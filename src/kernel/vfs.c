@@ -134,10 +134,11 @@ static uint64_t vfs_make_canonical(const char* start, char* out, const char* pat
 static uint64_t vfs_parse_path(char* out, const char* path)
 {
     vfs_context_t* context = &sched_process()->vfsContext;
-    LOCK_GUARD(&context->lock);
 
     if (path[0] == VFS_NAME_SEPARATOR) // Root path
     {
+        LOCK_GUARD(&context->lock);
+
         uint64_t labelLength = strchr(context->cwd, VFS_LABEL_SEPARATOR) - context->cwd;
         memcpy(out, context->cwd, labelLength);
 
@@ -180,6 +181,8 @@ static uint64_t vfs_parse_path(char* out, const char* path)
     }
     else // Relative path
     {
+        LOCK_GUARD(&context->lock);
+
         uint64_t labelLength = strchr(context->cwd, VFS_LABEL_SEPARATOR) - context->cwd;
         uint64_t cwdLength = strlen(context->cwd);
 
@@ -272,6 +275,25 @@ uint64_t vfs_unmount(const char* label)
     return 0;
 }
 
+// Resolves a parsed path to its volume and the path within that volume.
+static volume_t* vfs_resolve(char* parsedPath, char** rootPath)
+{
+    volume_t* volume = volume_get(parsedPath);
+    if (volume == NULL)
+    {
+        return NULLPTR(EPATH);
+    }
+
+    *rootPath = strchr(parsedPath, VFS_NAME_SEPARATOR);
+    if (*rootPath == NULL)
+    {
+        volume_deref(volume);
+        return NULLPTR(EPATH);
+    }
+
+    return volume;
+}
+
 file_t* vfs_open(const char* path)
 {
     char parsedPath[MAX_PATH];
@@ -280,10 +302,11 @@ file_t* vfs_open(const char* path)
         return NULLPTR(EPATH);
     }
 
-    volume_t* volume = volume_get(parsedPath);
+    char* rootPath;
+    volume_t* volume = vfs_resolve(parsedPath, &rootPath);
     if (volume == NULL)
     {
-        return NULLPTR(EPATH);
+        return NULL;
     }
 
     if (volume->ops->open == NULL)
@@ -292,21 +315,34 @@ file_t* vfs_open(const char* path)
         return NULLPTR(EACCES);
     }
 
-    char* rootPath = strchr(parsedPath, VFS_NAME_SEPARATOR);
-    if (rootPath == NULL)
+    file_t* file = volume->ops->open(volume, rootPath);
+    if (file == NULL)
     {
         volume_deref(volume);
         return NULL;
     }
 
-    file_t* file = volume->ops->open(volume, rootPath);
-    if (file == NULL)
+    return file;
+}
+
+static uint64_t vfs_stat_parsed(char* parsedPath, stat_t* buffer)
+{
+    char* rootPath;
+    volume_t* volume = vfs_resolve(parsedPath, &rootPath);
+    if (volume == NULL)
+    {
+        return ERR;
+    }
+
+    if (volume->ops->stat == NULL)
     {
         volume_deref(volume);
-        return NULL;
+        return ERROR(EACCES);
     }
 
-    return file;
+    uint64_t result = volume->ops->stat(volume, rootPath, buffer);
+    volume_deref(volume);
+    return result;
 }
 
 uint64_t vfs_stat(const char* path, stat_t* buffer)
@@ -317,31 +353,36 @@ uint64_t vfs_stat(const char* path, stat_t* buffer)
         return ERROR(EPATH);
     }
 
-    volume_t* volume = volume_get(parsedPath);
-    if (volume == NULL)
+    return vfs_stat_parsed(parsedPath, buffer);
+}
+
+uint64_t vfs_listdir(const char* path, dir_entry_t* entries, uint64_t amount)
+{
+    char parsedPath[MAX_PATH];
+    if (vfs_parse_path(parsedPath, path) == ERR)
     {
         return ERROR(EPATH);
     }
 
-    if (volume->ops->stat == NULL)
+    char* rootPath;
+    volume_t* volume = vfs_resolve(parsedPath, &rootPath);
+    if (volume == NULL)
     {
-        volume_deref(volume);
-        return ERROR(EACCES);
+        return ERR;
     }
 
-    char* rootPath = strchr(parsedPath, VFS_NAME_SEPARATOR);
-    if (rootPath == NULL)
+    if (volume->ops->listdir == NULL)
     {
         volume_deref(volume);
-        return ERR;
+        return ERROR(EACCES);
     }
 
-    uint64_t result = volume->ops->stat(volume, rootPath, buffer);
+    uint64_t result = volume->ops->listdir(volume, rootPath, entries, amount);
     volume_deref(volume);
     return result;
 }
 
-uint64_t vfs_listdir(const char* path, dir_entry_t* entries, uint64_t amount)
+uint64_t vfs_create(const char* path)
 {
     char parsedPath[MAX_PATH];
     if (vfs_parse_path(parsedPath, path) == ERR)
@@ -349,26 +390,46 @@ uint64_t vfs_listdir(const char* path, dir_entry_t* entries, uint64_t amount)
         return ERROR(EPATH);
     }
 
-    volume_t* volume = volume_get(parsedPath);
+    char* rootPath;
+    volume_t* volume = vfs_resolve(parsedPath, &rootPath);
     if (volume == NULL)
     {
-        return ERROR(EPATH);
+        return ERR;
     }
 
-    if (volume->ops->listdir == NULL)
+    if (volume->ops->create == NULL)
     {
         volume_deref(volume);
         return ERROR(EACCES);
     }
 
-    char* rootPath = strchr(parsedPath, VFS_NAME_SEPARATOR);
-    if (rootPath == NULL)
+    uint64_t result = volume->ops->create(volume, rootPath);
+    volume_deref(volume);
+    return result;
+}
+
+uint64_t vfs_unlink(const char* path)
+{
+    char parsedPath[MAX_PATH];
+    if (vfs_parse_path(parsedPath, path) == ERR)
+    {
+        return ERROR(EPATH);
+    }
+
+    char* rootPath;
+    volume_t* volume = vfs_resolve(parsedPath, &rootPath);
+    if (volume == NULL)
     {
-        volume_deref(volume);
         return ERR;
     }
 
-    uint64_t result = volume->ops->listdir(volume, rootPath, entries, amount);
+    if (volume->ops->unlink == NULL)
+    {
+        volume_deref(volume);
+        return ERROR(EACCES);
+    }
+
+    uint64_t result = volume->ops->unlink(volume, rootPath);
     volume_deref(volume);
     return result;
 }
@@ -394,7 +455,7 @@ uint64_t vfs_chdir(const char* path)
     }
 
     stat_t info;
-    if (vfs_stat(path, &info) == ERR)
+    if (vfs_stat_parsed(parsedPath, &info) == ERR)
     {
         return ERR;
     }
@@ -453,3 +514,114 @@ uint64_t vfs_poll(poll_file_t* files, uint64_t amount, nsec_t timeout)
 
     return events;
 }
+
+uint64_t vfs_readv(file_t* file, const iovec_t* iov, uint64_t amount)
+{
+    if (file->ops->readv != NULL)
+    {
+        return file->ops->readv(file, iov, amount);
+    }
+
+    if (file->ops->read == NULL)
+    {
+        return ERROR(EACCES);
+    }
+
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < amount; i++)
+    {
+        uint64_t result = file->ops->read(file, iov[i].base, iov[i].length);
+        if (result == ERR)
+        {
+            return total != 0 ? total : ERR;
+        }
+
+        total += result;
+        if (result != iov[i].length)
+        {
+            break;
+        }
+    }
+
+    return total;
+}
+
+uint64_t vfs_writev(file_t* file, const iovec_t* iov, uint64_t amount)
+{
+    if (file->ops->writev != NULL)
+    {
+        return file->ops->writev(file, iov, amount);
+    }
+
+    if (file->ops->write == NULL)
+    {
+        return ERROR(EACCES);
+    }
+
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < amount; i++)
+    {
+        uint64_t result = file->ops->write(file, iov[i].base, iov[i].length);
+        if (result == ERR)
+        {
+            return total != 0 ? total : ERR;
+        }
+
+        total += result;
+        if (result != iov[i].length)
+        {
+            break;
+        }
+    }
+
+    return total;
+}
+
+// The fallbacks emulate positional io by seeking, which is not atomic, filesystems should implement pread/pwrite directly.
+uint64_t vfs_pread(file_t* file, void* buffer, uint64_t count, uint64_t offset)
+{
+    if (file->ops->pread != NULL)
+    {
+        return file->ops->pread(file, buffer, count, offset);
+    }
+
+    if (file->ops->read == NULL || file->ops->seek == NULL)
+    {
+        return ERROR(EACCES);
+    }
+
+    uint64_t pos = file->ops->seek(file, 0, SEEK_CUR);
+    if (pos == ERR || file->ops->seek(file, offset, SEEK_SET) == ERR)
+    {
+        return ERR;
+    }
+
+    uint64_t result = file->ops->read(file, buffer, count);
+    file->ops->seek(file, pos, SEEK_SET);
+
+    return result;
+}
+
+uint64_t vfs_pwrite(file_t* file, const void* buffer, uint64_t count, uint64_t offset)
+{
+    if (file->ops->pwrite != NULL)
+    {
+        return file->ops->pwrite(file, buffer, count, offset);
+    }
+
+    if (file->ops->write == NULL || file->ops->seek == NULL)
+    {
+        return ERROR(EACCES);
+    }
+
+    uint64_t pos = file->ops->seek(file, 0, SEEK_CUR);
+    if (pos == ERR || file->ops->seek(file, offset, SEEK_SET) == ERR)
+    {
+        return ERR;
+    }
+
+    uint64_t result = file->ops->write(file, buffer, count);
+    file->ops->seek(file, pos, SEEK_SET);
+
+    return result;
+}
@@ -40,6 +40,8 @@ typedef uint64_t (*volume_unmount_t)(volume_t*);
 typedef file_t* (*volume_open_t)(volume_t*, const char*);
 typedef uint64_t (*volume_stat_t)(volume_t*, const char*, stat_t*);
 typedef uint64_t (*volume_listdir_t)(volume_t*, const char*, dir_entry_t*, uint64_t);
+typedef uint64_t (*volume_create_t)(volume_t*, const char*);
+typedef uint64_t (*volume_unlink_t)(volume_t*, const char*);
 
 typedef struct volume_ops
 {
@@ -47,6 +49,8 @@ typedef struct volume_ops
     volume_open_t open;
     volume_stat_t stat;
     volume_listdir_t listdir;
+    volume_create_t create;
+    volume_unlink_t unlink;
 } volume_ops_t;
 
 typedef struct volume
@@ -65,6 +69,11 @@ typedef uint64_t (*file_ioctl_t)(file_t*, uint64_t, void*, uint64_t);
 typedef uint64_t (*file_flush_t)(file_t*, const pixel_t*, uint64_t, const rect_t*);
 typedef void* (*file_mmap_t)(file_t*, void*, uint64_t, prot_t);
 typedef uint64_t (*file_status_t)(file_t*, poll_file_t*);
+typedef uint64_t (*file_readv_t)(file_t*, const iovec_t*, uint64_t);
+typedef uint64_t (*file_writev_t)(file_t*, const iovec_t*, uint64_t);
+typedef uint64_t (*file_pread_t)(file_t*, void*, uint64_t, uint64_t);
+typedef uint64_t (*file_pwrite_t)(file_t*, const void*, uint64_t, uint64_t);
+typedef uint64_t (*file_truncate_t)(file_t*, uint64_t);
 
 typedef struct file_ops
 {
@@ -76,6 +85,11 @@ typedef struct file_ops
     file_flush_t flush;
     file_mmap_t mmap;
     file_status_t status;
+    file_readv_t readv;
+    file_writev_t writev;
+    file_pread_t pread;
+    file_pwrite_t pwrite;
+    file_truncate_t truncate;
 } file_ops_t;
 
 typedef struct file
@@ -120,12 +134,24 @@ uint64_t vfs_stat(const char* path, stat_t* buffer);
 
 uint64_t vfs_listdir(const char* path, dir_entry_t* entries, uint64_t amount);
 
+uint64_t vfs_create(const char* path);
+
+uint64_t vfs_unlink(const char* path);
+
 uint64_t vfs_realpath(char* out, const char* path);
 
 uint64_t vfs_chdir(const char* path);
 
 uint64_t vfs_poll(poll_file_t* files, uint64_t amount, nsec_t timeout);
 
+uint64_t vfs_readv(file_t* file, const iovec_t* iov, uint64_t amount);
+
+uint64_t vfs_writev(file_t* file, const iovec_t* iov, uint64_t amount);
+
+uint64_t vfs_pread(file_t* file, void* buffer, uint64_t count, uint64_t offset);
+
+uint64_t vfs_pwrite(file_t* file, const void* buffer, uint64_t count, uint64_t offset);
+
 static inline uint64_t vfs_read(file_t* file, void* buffer, uint64_t count)
 {
     if (file->ops->read == NULL)
@@ -180,6 +206,15 @@ static inline void* vfs_mmap(file_t* file, void* address, uint64_t length, prot_
     return file->ops->mmap(file, address, length, prot);
 }
 
+static inline uint64_t vfs_truncate(file_t* file, uint64_t length)
+{
+    if (file->ops->truncate == NULL)
+    {
+        return ERROR(EACCES);
+    }
+    return file->ops->truncate(file, length);
+}
+
 static inline const char* vfs_basename(const char* path)
 {
     const char* base = strrchr(path, VFS_NAME_SEPARATOR);
@@ -272,6 +307,19 @@ static inline bool name_compare(const char* a, const char* b)
     return false;
 }
 
+// FNV-1a
+static inline uint64_t name_hash(const char* name)
+{
+    uint64_t hash = 0xCBF29CE484222325;
+    for (uint64_t i = 0; i < MAX_PATH && !VFS_END_OF_NAME(name[i]); i++)
+    {
+        hash ^= (uint8_t)name[i];
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+}
+
 static inline bool name_valid(const char* name)
 {
     uint64_t length = name_length(name);
@@ -5,8 +5,11 @@
 #include "pmm.h"
 #include "regs.h"
 #include "sched.h"
+#include "smp.h"
 #include "space.h"
+#include "trap.h"
 
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/math.h>
@@ -15,6 +18,24 @@ static pml_t* kernelPml;
 
 static list_t blocks;
 
+// A range of the kernel alloc region that has been freed.
+typedef struct
+{
+    list_entry_t entry;
+    uintptr_t start;
+    uintptr_t end;
+} vmm_range_t;
+
+// Everything from kernelFreeAddress to VMM_KERNEL_ALLOC_END is unused, freed ranges below it are kept sorted and coalesced
+// in kernelFree. A freed range may still be cached in the tlb of another cpu, so it waits in kernelRetired until a flush.
+static uintptr_t kernelFreeAddress;
+static list_t kernelFree;
+static list_t kernelRetired;
+static uint64_t kernelRetiredAmount;
+static lock_t kernelLock;
+
+static atomic_uint64_t flushPending;
+
 static void* vmm_find_free_region(space_t* space, uint64_t length)
 {
     uint64_t pageAmount = SIZE_IN_PAGES(length);
@@ -76,6 +97,13 @@ void vmm_init(efi_mem_map_t* memoryMap, boot_kernel_t* kernel, gop_buffer_t* gop
 
     gopBuffer->base = vmm_kernel_map(NULL, gopBuffer->base, gopBuffer->size);
 
+    kernelFreeAddress = VMM_KERNEL_ALLOC_BASE;
+    list_init(&kernelFree);
+    list_init(&kernelRetired);
+    kernelRetiredAmount = 0;
+    lock_init(&kernelLock);
+    atomic_init(&flushPending, 0);
+
     vmm_cpu_init();
 }
 
@@ -102,6 +130,207 @@ void* vmm_kernel_map(void* virtAddr, void* physAddr, uint64_t length)
     return virtAddr;
 }
 
+// Kernel mappings are global, so clearing the global enable is needed to flush them as well.
+static void vmm_tlb_flush(void)
+{
+    uint64_t cr4 = cr4_read();
+    cr4_write(cr4 & ~CR4_PAGE_GLOBAL_ENABLE);
+    cr4_write(cr4);
+}
+
+static void vmm_tlb_flush_ipi(trap_frame_t* trapFrame)
+{
+    vmm_tlb_flush();
+    atomic_fetch_sub(&flushPending, 1);
+}
+
+// Must be called with interrupts enabled, another cpu may be waiting for this one to flush as well.
+static void vmm_tlb_shootdown(void)
+{
+    cli_push();
+    vmm_tlb_flush();
+    if (smp_initialized())
+    {
+        atomic_fetch_add(&flushPending, smp_cpu_amount() - 1);
+        smp_send_others(vmm_tlb_flush_ipi);
+    }
+    cli_pop();
+
+    while (atomic_load(&flushPending) != 0)
+    {
+        asm volatile("pause");
+    }
+}
+
+static void vmm_kernel_insert(vmm_range_t* range)
+{
+    vmm_range_t* next;
+    LIST_FOR_EACH(next, &kernelFree)
+    {
+        if (next->start >= range->end)
+        {
+            break;
+        }
+    }
+
+    list_entry_t* prev = next->entry.prev;
+    if (prev != &kernelFree.head && ((vmm_range_t*)prev)->end == range->start)
+    {
+        ((vmm_range_t*)prev)->end = range->end;
+        free(range);
+        range = (vmm_range_t*)prev;
+    }
+    else
+    {
+        list_add(prev, &next->entry, &range->entry);
+    }
+
+    if (&next->entry != &kernelFree.head && range->end == next->start)
+    {
+        range->end = next->end;
+        list_remove(next);
+        free(next);
+    }
+
+    // A range that reaches the unused tail is given back to it.
+    if (range->end == kernelFreeAddress)
+    {
+        kernelFreeAddress = range->start;
+        list_remove(range);
+        free(range);
+    }
+}
+
+static uintptr_t vmm_kernel_find(uint64_t pageAmount)
+{
+    vmm_range_t* range;
+    LIST_FOR_EACH(range, &kernelFree)
+    {
+        if ((range->end - range->start) / PAGE_SIZE >= pageAmount)
+        {
+            uintptr_t start = range->start;
+            range->start += pageAmount * PAGE_SIZE;
+            if (range->start == range->end)
+            {
+                list_remove(range);
+                free(range);
+            }
+            return start;
+        }
+    }
+
+    if (pageAmount > (VMM_KERNEL_ALLOC_END - kernelFreeAddress) / PAGE_SIZE)
+    {
+        return 0;
+    }
+
+    uintptr_t start = kernelFreeAddress;
+    kernelFreeAddress += pageAmount * PAGE_SIZE;
+    return start;
+}
+
+// Retired ranges are made reusable in batches, once there are enough of them or when the region would otherwise be full,
+// so that the cost of flushing every cpu is rarely paid. Flushing requires interrupts, without them retired ranges wait.
+static uintptr_t vmm_kernel_reserve(uint64_t pageAmount)
+{
+    bool canFlush = rflags_read() & RFLAGS_INTERRUPT_ENABLE;
+
+    lock_acquire(&kernelLock);
+    uintptr_t start = vmm_kernel_find(pageAmount);
+    if (!canFlush || (kernelRetiredAmount < VMM_KERNEL_RETIRED_MAX && (start != 0 || kernelRetiredAmount == 0)))
+    {
+        lock_release(&kernelLock);
+        return start;
+    }
+
+    list_t retired;
+    list_init(&retired);
+    vmm_range_t* range;
+    while ((range = list_pop(&kernelRetired)) != NULL)
+    {
+        list_push(&retired, range);
+    }
+    kernelRetiredAmount = 0;
+    lock_release(&kernelLock);
+
+    vmm_tlb_shootdown();
+
+    lock_acquire(&kernelLock);
+    while ((range = list_pop(&retired)) != NULL)
+    {
+        vmm_kernel_insert(range);
+    }
+    if (start == 0)
+    {
+        start = vmm_kernel_find(pageAmount);
+    }
+    lock_release(&kernelLock);
+
+    return start;
+}
+
+static void vmm_kernel_retire(uintptr_t start, uint64_t pageAmount)
+{
+    vmm_range_t* range = malloc(sizeof(vmm_range_t));
+    if (range == NULL)
+    {
+        // Only address space is lost, the pages themselves are already free.
+        return;
+    }
+    list_entry_init(&range->entry);
+    range->start = start;
+    range->end = start + pageAmount * PAGE_SIZE;
+
+    list_push(&kernelRetired, range);
+    kernelRetiredAmount++;
+}
+
+void* vmm_kernel_alloc(uint64_t length)
+{
+    uint64_t pageAmount = SIZE_IN_PAGES(length);
+    if (pageAmount == 0)
+    {
+        return NULLPTR(EINVAL);
+    }
+
+    // The size is chosen by a process, so running out of memory must fail the allocation instead of panicking.
+    if (pageAmount > pmm_free_amount())
+    {
+        return NULLPTR(ENOMEM);
+    }
+
+    uintptr_t start = vmm_kernel_reserve(pageAmount);
+    if (start == 0)
+    {
+        return NULLPTR(ENOMEM);
+    }
+
+    LOCK_GUARD(&kernelLock);
+    for (uint64_t i = 0; i < pageAmount; i++)
+    {
+        void* page = pmm_try_alloc();
+        if (page == NULL)
+        {
+            pml_unmap(kernelPml, (void*)start, i);
+            vmm_kernel_retire(start, pageAmount);
+            return NULLPTR(ENOMEM);
+        }
+
+        void* address = (void*)(start + i * PAGE_SIZE);
+        pml_map(kernelPml, address, VMM_HIGHER_TO_LOWER(page), 1, PAGE_WRITE | PAGE_OWNED | VMM_KERNEL_PAGES);
+    }
+
+    return (void*)start;
+}
+
+void vmm_kernel_free(void* virtAddr, uint64_t length)
+{
+    LOCK_GUARD(&kernelLock);
+
+    pml_unmap(kernelPml, virtAddr, SIZE_IN_PAGES(length));
+    vmm_kernel_retire((uintptr_t)virtAddr, SIZE_IN_PAGES(length));
+}
+
 void* vmm_alloc(void* virtAddr, uint64_t length, prot_t prot)
 {
     space_t* space = &sched_process()->space;
@@ -177,6 +406,42 @@ void* vmm_map(void* virtAddr, void* physAddr, uint64_t length, prot_t prot)
     return virtAddr;
 }
 
+void* vmm_map_pages(void* virtAddr, void** pages, uint64_t amount, prot_t prot)
+{
+    space_t* space = &sched_process()->space;
+    LOCK_GUARD(&space->lock);
+
+    if (amount == 0)
+    {
+        return NULLPTR(EINVAL);
+    }
+
+    uint64_t flags = vmm_prot_to_flags(prot);
+    if (flags == ERR)
+    {
+        return NULLPTR(EACCES);
+    }
+
+    uint64_t length = amount * PAGE_SIZE;
+    if (virtAddr == NULL)
+    {
+        virtAddr = vmm_find_free_region(space, length);
+    }
+    vmm_align_region(&virtAddr, &length);
+
+    if (pml_mapped(space->pml, virtAddr, amount))
+    {
+        return NULLPTR(EEXIST);
+    }
+
+    for (uint64_t i = 0; i < amount; i++)
+    {
+        pml_map(space->pml, (void*)((uint64_t)virtAddr + i * PAGE_SIZE), pages[i], 1, flags);
+    }
+
+    return virtAddr;
+}
+
 uint64_t vmm_unmap(void* virtAddr, uint64_t length)
 {
     vmm_align_region(&virtAddr, &length);
@@ -212,6 +477,20 @@ uint64_t vmm_protect(void* virtAddr, uint64_t length, prot_t prot)
         return ERROR(EFAULT);
     }
 
+    // Pages not owned by this space, like shared read only views of file data, may only keep the access they were mapped
+    // with, a writable view of them must come from the owner.
+    if (flags & PAGE_WRITE)
+    {
+        for (uint64_t i = 0; i < SIZE_IN_PAGES(length); i++)
+        {
+            uint64_t pageFlags = pml_flags(space->pml, (void*)((uint64_t)virtAddr + i * PAGE_SIZE));
+            if (!(pageFlags & PAGE_OWNED) && !(pageFlags & PAGE_WRITE))
+            {
+                return ERROR(EACCES);
+            }
+        }
+    }
+
     pml_change_flags(space->pml, virtAddr, SIZE_IN_PAGES(length), flags);
 
     return 0;
@@ -13,6 +13,13 @@
 
 #define VMM_KERNEL_PAGES (PAGE_GLOBAL)
 
+// Region used by vmm_kernel_alloc(), shares the last pml4 entry with the kernel so every address space sees it.
+#define VMM_KERNEL_ALLOC_BASE 0xFFFFFF8000000000
+#define VMM_KERNEL_ALLOC_END 0xFFFFFFFF00000000
+
+// Freed kernel ranges that may be waiting for a tlb flush before they are reused.
+#define VMM_KERNEL_RETIRED_MAX 64
+
 #define VMM_HIGHER_TO_LOWER(address) ((void*)((uint64_t)(address) - VMM_HIGHER_HALF_BASE))
 #define VMM_LOWER_TO_HIGHER(address) ((void*)((uint64_t)(address) + VMM_HIGHER_HALF_BASE))
 
@@ -24,10 +31,19 @@ pml_t* vmm_kernel_pml(void);
 
 void* vmm_kernel_map(void* virtAddr, void* physAddr, uint64_t length);
 
+// Allocates virtually contiguous kernel pages, the pages are not zeroed. Fails with ENOMEM instead of panicking when memory
+// or the region runs out, freed ranges are reused.
+void* vmm_kernel_alloc(uint64_t length);
+
+void vmm_kernel_free(void* virtAddr, uint64_t length);
+
 void* vmm_alloc(void* virtAddr, uint64_t length, prot_t prot);
 
 void* vmm_map(void* virtAddr, void* physAddr, uint64_t length, prot_t prot);
 
+// Maps an array of physical pages to a contiguous virtual region, the pages are not owned by the address space.
+void* vmm_map_pages(void* virtAddr, void** pages, uint64_t amount, prot_t prot);
+
 uint64_t vmm_unmap(void* virtAddr, uint64_t length);
 
 uint64_t vmm_protect(void* virtAddr, uint64_t length, prot_t prot);
@@ -5,6 +5,8 @@
 #include <sys/dwm.h>
 #include <sys/win.h>
 
+#define SHELL_MAX_MSG 16
+
 static win_t** windows;
 static uint32_t windowAmount;
 
@@ -21,24 +23,34 @@ void shell_loop(void)
         win_poll(windows, windowAmount, NEVER);
         for (int64_t i = 0; i < windowAmount; i++)
         {
-            msg_t msg = {0};
-            while (win_receive(windows[i], &msg, 0))
+            msg_t msgs[SHELL_MAX_MSG];
+            uint64_t amount;
+            bool quit = false;
+            while (!quit && (amount = win_receive_batch(windows[i], msgs, SHELL_MAX_MSG, 0)) != 0 && amount != ERR)
             {
-                win_dispatch(windows[i], &msg);
-
-                if (msg.type == LMSG_QUIT)
+                for (uint64_t j = 0; j < amount; j++)
                 {
-                    win_free(windows[i]);
+                    win_dispatch(windows[i], &msgs[j]);
 
-                    if (i != windowAmount - 1)
+                    if (msgs[j].type == LMSG_QUIT)
                     {
-                        memmove(&windows[i], &windows[i + 1], sizeof(win_t*) * (windowAmount - i - 1));
+                        quit = true;
+                        break;
                     }
-                    windowAmount--;
-                    i--;
-                    break;
                 }
             }
+
+            if (quit)
+            {
+                win_free(windows[i]);
+
+                if (i != windowAmount - 1)
+                {
+                    memmove(&windows[i], &windows[i + 1], sizeof(win_t*) * (windowAmount - i - 1));
+                }
+                windowAmount--;
+                i--;
+            }
         }
     }
 }
@@ -1,6 +1,38 @@
 #include "wall.h"
 #include "sys/win.h"
 
+#include <stdlib.h>
+#include <sys/gfx.h>
+
+// The wallpaper is optional and may be of any size, it is scaled to the screen once and the scaled copy is reused.
+static gfx_t image;
+static gfx_scaled_t scaled;
+
+static void wall_image_load(void)
+{
+    gfx_fbmp_t* fbmp = gfx_fbmp_load("/lib/shell/wall.fbmp");
+    if (fbmp == NULL)
+    {
+        return;
+    }
+
+    image.buffer = malloc((uint64_t)fbmp->width * fbmp->height * sizeof(pixel_t));
+    if (image.buffer == NULL)
+    {
+        gfx_fbmp_cleanup(fbmp);
+        return;
+    }
+    image.width = fbmp->width;
+    image.height = fbmp->height;
+    image.stride = fbmp->width;
+    image.flags = GFX_NONE;
+    image.invalidRegion = REGION_INIT();
+
+    point_t point = {0};
+    gfx_fbmp(&image, fbmp, &point);
+    gfx_fbmp_cleanup(fbmp);
+}
+
 static uint64_t procedure(win_t* window, const msg_t* msg)
 {
     switch (msg->type)
@@ -13,7 +45,21 @@ static uint64_t procedure(win_t* window, const msg_t* msg)
         rect_t rect;
         win_client_rect(window, &rect);
 
-        gfx_rect(&gfx, &rect, 0xFF427F99);
+        const gfx_t* wallpaper = NULL;
+        if (image.buffer != NULL)
+        {
+            wallpaper = gfx_scaled_get(&scaled, &image, RECT_WIDTH(&rect), RECT_HEIGHT(&rect), GFX_BILINEAR);
+        }
+
+        if (wallpaper != NULL)
+        {
+            point_t point = {0};
+            gfx_transfer(&gfx, wallpaper, &rect, &point);
+        }
+        else
+        {
+            gfx_rect(&gfx, &rect, 0xFF427F99);
+        }
 
         win_draw_end(window, &gfx);
     }
@@ -25,6 +71,8 @@ static uint64_t procedure(win_t* window, const msg_t* msg)
 
 win_t* wall_new(void)
 {
+    wall_image_load();
+
     rect_t rect;
     win_screen_rect(&rect);
     return win_new("Wallpaper", &rect, DWM_WALL, WIN_NONE, procedure);
@@ -1,12 +1,90 @@
+#include <immintrin.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/gfx.h>
 #include <sys/io.h>
 #include <sys/math.h>
+#include <sys/proc.h>
+
+static void gfx_glyph_cache_free(gfx_psf_t* psf);
 
 #ifndef __EMBED__
 
+// Maps a file read only, if the filesystem cant map files it is read into anonymous memory instead so that both cases
+// are released with munmap.
+static void* gfx_file_map(fd_t file, uint64_t size)
+{
+    void* map = mmap(file, NULL, size, PROT_READ);
+    if (map != NULL)
+    {
+        return map;
+    }
+
+    fd_t zero = open("sys:/zero");
+    if (zero == ERR)
+    {
+        return NULL;
+    }
+    map = mmap(zero, NULL, size, PROT_READ | PROT_WRITE);
+    close(zero);
+    if (map == NULL)
+    {
+        return NULL;
+    }
+
+    if (pread(file, map, size, 0) != size)
+    {
+        munmap(map, size);
+        return NULL;
+    }
+
+    return map;
+}
+
+static uint64_t gfx_fbmp_size(const gfx_fbmp_t* fbmp)
+{
+    if (fbmp->magic == FBMP2_MAGIC)
+    {
+        const gfx_fbmp2_t* fbmp2 = (const gfx_fbmp2_t*)fbmp;
+        return fbmp2->offsets[fbmp2->tileAmount];
+    }
+
+    return sizeof(gfx_fbmp_t) + (uint64_t)fbmp->width * fbmp->height * sizeof(pixel_t);
+}
+
+static uint64_t gfx_fbmp2_tile_amount(const gfx_fbmp2_t* fbmp2)
+{
+    uint64_t columns = (fbmp2->width + fbmp2->tileSize - 1) / fbmp2->tileSize;
+    uint64_t rows = (fbmp2->height + fbmp2->tileSize - 1) / fbmp2->tileSize;
+    return columns * rows;
+}
+
+static uint64_t gfx_fbmp2_table_end(const gfx_fbmp2_t* fbmp2)
+{
+    return sizeof(gfx_fbmp2_t) + ((uint64_t)fbmp2->tileAmount + 1) * sizeof(uint32_t);
+}
+
+// The decoder trusts the offsets, every tile must lie between the offset table and the end of the file without overlapping
+// the tile before it.
+static bool gfx_fbmp2_valid(const gfx_fbmp2_t* fbmp2, uint64_t size)
+{
+    if (fbmp2->offsets[0] < gfx_fbmp2_table_end(fbmp2) || fbmp2->offsets[fbmp2->tileAmount] != size)
+    {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < fbmp2->tileAmount; i++)
+    {
+        if (fbmp2->offsets[i] > fbmp2->offsets[i + 1])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 gfx_fbmp_t* gfx_fbmp_load(const char* path)
 {
     fd_t file = open(path);
@@ -15,37 +93,57 @@ gfx_fbmp_t* gfx_fbmp_load(const char* path)
         return NULL;
     }
 
-    uint64_t fileSize = seek(file, 0, SEEK_END);
-    seek(file, 0, SEEK_SET);
+    gfx_fbmp2_t header;
+    if (pread(file, &header, sizeof(gfx_fbmp_t), 0) != sizeof(gfx_fbmp_t))
+    {
+        close(file);
+        return NULL;
+    }
 
-    gfx_fbmp_t* image = malloc(fileSize);
-    if (image == NULL)
+    uint64_t size;
+    if (header.magic == FBMP_MAGIC)
+    {
+        size = gfx_fbmp_size((gfx_fbmp_t*)&header);
+    }
+    else if (header.magic == FBMP2_MAGIC)
+    {
+        uint32_t end;
+        if (pread(file, &header, sizeof(gfx_fbmp2_t), 0) != sizeof(gfx_fbmp2_t) || header.tileSize == 0 ||
+            header.tileAmount != gfx_fbmp2_tile_amount(&header) ||
+            pread(file, &end, sizeof(uint32_t), sizeof(gfx_fbmp2_t) + header.tileAmount * sizeof(uint32_t)) !=
+                sizeof(uint32_t) ||
+            end < gfx_fbmp2_table_end(&header))
+        {
+            close(file);
+            return NULL;
+        }
+        size = end;
+    }
+    else
     {
         close(file);
         return NULL;
     }
 
-    if (read(file, image, fileSize) != fileSize)
+    if (seek(file, 0, SEEK_END) < size)
     {
         close(file);
-        free(image);
         return NULL;
     }
 
+    gfx_fbmp_t* image = gfx_file_map(file, size);
     close(file);
-
-    if (image->magic != FBMP_MAGIC)
+    if (image != NULL && image->magic == FBMP2_MAGIC && !gfx_fbmp2_valid((const gfx_fbmp2_t*)image, size))
     {
-        free(image);
+        munmap(image, size);
         return NULL;
     }
-
     return image;
 }
 
 void gfx_fbmp_cleanup(gfx_fbmp_t* fbmp)
 {
-    free(fbmp);
+    munmap(fbmp, gfx_fbmp_size(fbmp));
 }
 
 static uint64_t gfx_psf1_load(gfx_psf_t* psf, fd_t file)
@@ -56,7 +154,7 @@ static uint64_t gfx_psf1_load(gfx_psf_t* psf, fd_t file)
         uint8_t mode;
         uint8_t glyphSize;
     } header;
-    if (read(file, &header, sizeof(header)) != sizeof(header))
+    if (pread(file, &header, sizeof(header), 0) != sizeof(header))
     {
         return ERR;
     }
@@ -71,15 +169,15 @@ static uint64_t gfx_psf1_load(gfx_psf_t* psf, fd_t file)
     psf->glyphSize = header.glyphSize;
     psf->glyphAmount = header.mode & PSF1_MODE_512 ? 512 : 256;
 
-    uint64_t glyphBufferSize = psf->glyphAmount * psf->glyphSize;
-
-    psf->glyphs = malloc(glyphBufferSize);
-    if (read(file, psf->glyphs, glyphBufferSize) != glyphBufferSize)
+    psf->mapSize = sizeof(header) + psf->glyphAmount * psf->glyphSize;
+    psf->map = gfx_file_map(file, psf->mapSize);
+    if (psf->map == NULL)
     {
-        free(psf->glyphs);
         return ERR;
     }
 
+    psf->glyphs = (uint8_t*)psf->map + sizeof(header);
+    psf->cache = NULL;
     return 0;
 }
 
@@ -96,7 +194,7 @@ static uint64_t gfx_psf2_load(gfx_psf_t* psf, fd_t file)
         uint32_t height;
         uint32_t width;
     } header;
-    if (read(file, &header, sizeof(header)) != sizeof(header))
+    if (pread(file, &header, sizeof(header), 0) != sizeof(header))
     {
         return ERR;
     }
@@ -111,15 +209,15 @@ static uint64_t gfx_psf2_load(gfx_psf_t* psf, fd_t file)
     psf->glyphSize = header.glyphSize;
     psf->glyphAmount = header.glyphAmount;
 
-    uint64_t glyphBufferSize = psf->glyphAmount * psf->glyphSize;
-
-    psf->glyphs = malloc(glyphBufferSize);
-    if (read(file, psf->glyphs, glyphBufferSize) != glyphBufferSize)
+    psf->mapSize = header.headerSize + psf->glyphAmount * psf->glyphSize;
+    psf->map = gfx_file_map(file, psf->mapSize);
+    if (psf->map == NULL)
     {
-        free(psf->glyphs);
         return ERR;
     }
 
+    psf->glyphs = (uint8_t*)psf->map + header.headerSize;
+    psf->cache = NULL;
     return 0;
 }
 
@@ -132,11 +230,11 @@ uint64_t gfx_psf_load(gfx_psf_t* psf, const char* path)
     }
 
     uint8_t firstByte;
-    if (read(file, &firstByte, sizeof(firstByte)) != sizeof(firstByte))
+    if (pread(file, &firstByte, sizeof(firstByte), 0) != sizeof(firstByte))
     {
+        close(file);
         return ERR;
     }
-    seek(file, 0, SEEK_SET);
 
     uint64_t result;
     if (firstByte == 0x36) // Is psf1
@@ -158,302 +256,1739 @@ uint64_t gfx_psf_load(gfx_psf_t* psf, const char* path)
 
 void gfx_psf_cleanup(gfx_psf_t* psf)
 {
-    free(psf->glyphs);
+    gfx_glyph_cache_free(psf);
+    munmap(psf->map, psf->mapSize);
 }
 
 #endif
 
-void gfx_fbmp(gfx_t* gfx, const gfx_fbmp_t* fbmp, const point_t* point)
+// Row routines for filling, copying and blending pixels, the best variant the cpu supports is picked at first use. In
+// the kernel they may only run on kernel threads, those have their own simd context that is saved on every switch,
+// never on behalf of a system call where the vector registers still belong to user space.
+
+#define GFX_ALPHA_MASK 0xFF000000
+
+// Equal to x / 0xFF for every x up to 0xFF * 0xFF, which covers the product of two channels.
+#define GFX_DIV255(x) (((x) + 1 + ((x) >> 8)) >> 8)
+
+#define GFX_CPUID_EDX_SSE2 (1 << 26)
+#define GFX_CPUID_ECX_OSXSAVE (1 << 27)
+#define GFX_CPUID_ECX_AVX (1 << 28)
+#define GFX_CPUID_EBX_AVX2 (1 << 5)
+#define GFX_CPUID_EBX_AVX512F (1 << 16)
+
+#define GFX_XCR0_AVX 0x6
+#define GFX_XCR0_AVX512 0xE6
+
+typedef struct
+{
+    void (*fill)(pixel_t* dest, pixel_t pixel, uint64_t count);
+    void (*copy)(pixel_t* dest, const pixel_t* src, uint64_t count);
+    void (*blend)(pixel_t* dest, const pixel_t* src, uint64_t count);
+    void (*blendPremultiplied)(pixel_t* dest, const pixel_t* src, uint64_t count);
+    void (*lerp)(pixel_t* dest, const pixel_t* a, const pixel_t* b, uint32_t weight, uint64_t count);
+    void (*expand)(pixel_t* dest, uint8_t bits, pixel_t foreground, pixel_t background);
+} gfx_pixel_ops_t;
+
+static void gfx_fill_scalar(pixel_t* dest, pixel_t pixel, uint64_t count)
 {
-    for (uint32_t y = 0; y < fbmp->height; y++)
+    uint64_t pixel64 = ((uint64_t)pixel << 32) | pixel;
+
+    while (count >= 2)
     {
-        for (uint32_t x = 0; x < fbmp->width; x++)
-        {
-            gfx->buffer[(point->x + x) + (point->y + y) * gfx->stride] = fbmp->data[x + y * fbmp->width];
-        }
+        *(uint64_t*)dest = pixel64;
+        dest += 2;
+        count -= 2;
     }
 
-    rect_t rect = RECT_INIT_DIM(point->x, point->x, fbmp->width, fbmp->height);
-    gfx_invalidate(gfx, &rect);
+    if (count != 0)
+    {
+        *dest = pixel;
+    }
 }
 
-void gfx_psf_char(gfx_t* gfx, const gfx_psf_t* psf, const point_t* point, uint64_t height, char chr, pixel_t foreground,
-    pixel_t background)
+static void gfx_copy_scalar(pixel_t* dest, const pixel_t* src, uint64_t count)
 {
-    uint64_t scale = MAX(1, height / psf->height);
-    const uint8_t* glyph = psf->glyphs + chr * psf->glyphSize;
+    memcpy(dest, src, count * sizeof(pixel_t));
+}
 
-    for (uint64_t y = 0; y < psf->height * scale; y++)
+// Returns the length of the run of pixels at the start of src that all have the given alpha.
+static uint64_t gfx_alpha_run(const pixel_t* src, uint64_t count, uint8_t alpha)
+{
+    uint64_t i = 0;
+    while (i < count && PIXEL_ALPHA(src[i]) == alpha)
     {
-        for (uint64_t x = 0; x < psf->width * scale; x++)
-        {
-            pixel_t pixel = (glyph[y / scale] & (0b10000000 >> (x / scale))) != 0 ? foreground : background;
-            PIXEL_BLEND(&gfx->buffer[(point->x + x) + (point->y + y) * gfx->stride], &pixel);
-        }
+        i++;
     }
+    return i;
 }
 
-void gfx_psf(gfx_t* gfx, const gfx_psf_t* psf, const rect_t* rect, gfx_align_t xAlign, gfx_align_t yAlign, uint64_t height,
-    const char* str, pixel_t foreground, pixel_t background)
+// Opaque runs are copied and transparent runs skipped, only translucent pixels are blended. A transparent source pixel
+// leaves the destination as is, even a transparent one that PIXEL_BLEND would have cleared.
+static void gfx_blend_scalar(pixel_t* dest, const pixel_t* src, uint64_t count)
 {
-    uint64_t scale = MAX(1, height / psf->height);
-    height = psf->height * scale;
-    int64_t width = strlen(str) * psf->width * scale;
-
-    point_t point;
-    switch (xAlign)
-    {
-    case GFX_CENTER:
-    {
-        point.x = MAX(rect->left, (rect->right + rect->left - width) / 2);
-    }
-    break;
-    case GFX_MAX:
-    {
-        point.x = MAX(rect->left, rect->right - width);
-    }
-    break;
-    case GFX_MIN:
+    uint64_t i = 0;
+    while (i < count)
     {
-        point.x = rect->left;
+        uint8_t alpha = PIXEL_ALPHA(src[i]);
+        if (alpha == 0xFF)
+        {
+            uint64_t run = gfx_alpha_run(&src[i], count - i, 0xFF);
+            memcpy(&dest[i], &src[i], run * sizeof(pixel_t));
+            i += run;
+        }
+        else if (alpha == 0)
+        {
+            i += gfx_alpha_run(&src[i], count - i, 0);
+        }
+        else if (PIXEL_ALPHA(dest[i]) == 0xFF)
+        {
+            uint32_t inverse = 0xFF - alpha;
+            dest[i] = PIXEL_ARGB(0xFFU, GFX_DIV255(PIXEL_RED(src[i]) * alpha + PIXEL_RED(dest[i]) * inverse),
+                GFX_DIV255(PIXEL_GREEN(src[i]) * alpha + PIXEL_GREEN(dest[i]) * inverse),
+                GFX_DIV255(PIXEL_BLUE(src[i]) * alpha + PIXEL_BLUE(dest[i]) * inverse));
+            i++;
+        }
+        else
+        {
+            PIXEL_BLEND(&dest[i], &src[i]);
+            i++;
+        }
     }
-    break;
-    default:
+}
+
+// With premultiplied pixels every channel, alpha included, is src + dest * (1 - srcAlpha).
+static void gfx_blend_premultiplied_scalar(pixel_t* dest, const pixel_t* src, uint64_t count)
+{
+    uint64_t i = 0;
+    while (i < count)
     {
-        return;
-    }
+        uint8_t alpha = PIXEL_ALPHA(src[i]);
+        if (alpha == 0xFF)
+        {
+            uint64_t run = gfx_alpha_run(&src[i], count - i, 0xFF);
+            memcpy(&dest[i], &src[i], run * sizeof(pixel_t));
+            i += run;
+        }
+        else if (alpha == 0)
+        {
+            i += gfx_alpha_run(&src[i], count - i, 0);
+        }
+        else
+        {
+            uint32_t inverse = 0xFF - alpha;
+            dest[i] = PIXEL_ARGB(alpha + GFX_DIV255(PIXEL_ALPHA(dest[i]) * inverse),
+                PIXEL_RED(src[i]) + GFX_DIV255(PIXEL_RED(dest[i]) * inverse),
+                PIXEL_GREEN(src[i]) + GFX_DIV255(PIXEL_GREEN(dest[i]) * inverse),
+                PIXEL_BLUE(src[i]) + GFX_DIV255(PIXEL_BLUE(dest[i]) * inverse));
+            i++;
+        }
     }
+}
 
-    switch (yAlign)
-    {
-    case GFX_CENTER:
+// Interpolates every channel as (a * (256 - weight) + b * weight) / 256 for a weight below 256, red and blue are done
+// together as are alpha and green since no product can carry into the neighbouring channel.
+static inline pixel_t gfx_lerp_pixel(pixel_t a, pixel_t b, uint32_t weight)
+{
+    uint32_t inverse = 0x100 - weight;
+    uint32_t redBlue = (((a & 0xFF00FF) * inverse + (b & 0xFF00FF) * weight) >> 8) & 0xFF00FF;
+    uint32_t alphaGreen = (((a >> 8) & 0xFF00FF) * inverse + ((b >> 8) & 0xFF00FF) * weight) & 0xFF00FF00;
+    return alphaGreen | redBlue;
+}
+
+static void gfx_lerp_scalar(pixel_t* dest, const pixel_t* a, const pixel_t* b, uint32_t weight, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++)
     {
-        point.y = MAX(rect->top, (rect->bottom + rect->top - (int64_t)height) / 2);
+        dest[i] = gfx_lerp_pixel(a[i], b[i], weight);
     }
-    break;
-    case GFX_MAX:
+}
+
+static void gfx_expand_scalar(pixel_t* dest, uint8_t bits, pixel_t foreground, pixel_t background)
+{
+    for (uint64_t i = 0; i < 8; i++)
     {
-        point.y = MAX(rect->top, rect->bottom - (int64_t)height);
+        dest[i] = (bits & (0b10000000 >> i)) != 0 ? foreground : background;
     }
-    break;
-    case GFX_MIN:
+}
+
+static const gfx_pixel_ops_t scalarOps = {
+    .fill = gfx_fill_scalar,
+    .copy = gfx_copy_scalar,
+    .blend = gfx_blend_scalar,
+    .blendPremultiplied = gfx_blend_premultiplied_scalar,
+    .lerp = gfx_lerp_scalar,
+    .expand = gfx_expand_scalar,
+};
+
+__attribute__((target("sse2"))) static void gfx_fill_sse2(pixel_t* dest, pixel_t pixel, uint64_t count)
+{
+    __m128i value = _mm_set1_epi32(pixel);
+
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4)
     {
-        point.y = rect->top;
+        _mm_storeu_si128((__m128i*)&dest[i], value);
     }
-    break;
-    default:
+    gfx_fill_scalar(&dest[i], pixel, count - i);
+}
+
+__attribute__((target("sse2"))) static void gfx_copy_sse2(pixel_t* dest, const pixel_t* src, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4)
     {
-        return;
-    }
+        _mm_storeu_si128((__m128i*)&dest[i], _mm_loadu_si128((const __m128i*)&src[i]));
     }
+    gfx_copy_scalar(&dest[i], &src[i], count - i);
+}
 
-    if (RECT_WIDTH(rect) < width)
+// Blends two pixels widened to 16 bit channels over an opaque destination, the division by 255 is exact for the
+// products involved so the result matches PIXEL_BLEND.
+__attribute__((target("sse2"))) static inline __m128i gfx_blend_wide_sse2(__m128i src, __m128i dest)
+{
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, 0xFF), 0xFF);
+    __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(0xFF), alpha);
+
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(src, alpha), _mm_mullo_epi16(dest, inverse));
+    sum = _mm_add_epi16(_mm_add_epi16(sum, _mm_set1_epi16(1)), _mm_srli_epi16(sum, 8));
+    return _mm_srli_epi16(sum, 8);
+}
+
+__attribute__((target("sse2"))) static inline __m128i gfx_blend_premultiplied_wide_sse2(__m128i src, __m128i dest)
+{
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, 0xFF), 0xFF);
+    __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(0xFF), alpha);
+
+    __m128i product = _mm_mullo_epi16(dest, inverse);
+    product = _mm_add_epi16(_mm_add_epi16(product, _mm_set1_epi16(1)), _mm_srli_epi16(product, 8));
+    return _mm_add_epi16(src, _mm_srli_epi16(product, 8));
+}
+
+__attribute__((target("sse2"))) static void gfx_blend_sse2(pixel_t* dest, const pixel_t* src, uint64_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32(GFX_ALPHA_MASK);
+
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4)
     {
-        for (uint64_t i = 0; i < RECT_WIDTH(rect) / (psf->width * scale) - 3; i++)
+        __m128i srcPixels = _mm_loadu_si128((const __m128i*)&src[i]);
+        __m128i destPixels = _mm_loadu_si128((const __m128i*)&dest[i]);
+
+        __m128i srcAlpha = _mm_and_si128(srcPixels, alphaMask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(srcAlpha, alphaMask)) == 0xFFFF)
         {
-            gfx_psf_char(gfx, psf, &point, height, str[i], foreground, background);
-            point.x += psf->width * scale;
+            _mm_storeu_si128((__m128i*)&dest[i], srcPixels);
+            continue;
         }
 
-        for (uint64_t i = 0; i < 3; i++)
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(srcAlpha, zero)) == 0xFFFF)
         {
-            gfx_psf_char(gfx, psf, &point, height, '.', foreground, background);
-            point.x += psf->width * scale;
+            continue;
         }
-    }
-    else
-    {
-        const char* chr = str;
-        uint64_t offset = 0;
-        while (*chr != '\0')
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(destPixels, alphaMask), alphaMask)) != 0xFFFF)
         {
-            gfx_psf_char(gfx, psf, &point, height, *chr, foreground, background);
-            point.x += psf->width * scale;
-            chr++;
+            gfx_blend_scalar(&dest[i], &src[i], 4);
+            continue;
         }
+
+        __m128i low = gfx_blend_wide_sse2(_mm_unpacklo_epi8(srcPixels, zero), _mm_unpacklo_epi8(destPixels, zero));
+        __m128i high = gfx_blend_wide_sse2(_mm_unpackhi_epi8(srcPixels, zero), _mm_unpackhi_epi8(destPixels, zero));
+        _mm_storeu_si128((__m128i*)&dest[i], _mm_or_si128(_mm_packus_epi16(low, high), alphaMask));
     }
+    gfx_blend_scalar(&dest[i], &src[i], count - i);
 }
 
-void gfx_rect(gfx_t* gfx, const rect_t* rect, pixel_t pixel)
+__attribute__((target("sse2"))) static void gfx_blend_premultiplied_sse2(pixel_t* dest, const pixel_t* src,
+    uint64_t count)
 {
-    uint64_t pixel64 = ((uint64_t)pixel << 32) | pixel;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32(GFX_ALPHA_MASK);
 
-    for (int64_t y = rect->top; y < rect->bottom; y++)
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4)
     {
-        uint64_t count = (rect->right - rect->left) * sizeof(pixel_t);
-        uint8_t* ptr = (uint8_t*)&gfx->buffer[rect->left + y * gfx->stride];
+        __m128i srcPixels = _mm_loadu_si128((const __m128i*)&src[i]);
 
-        while (count >= 64)
+        __m128i srcAlpha = _mm_and_si128(srcPixels, alphaMask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(srcAlpha, alphaMask)) == 0xFFFF)
         {
-            *(uint64_t*)(ptr + 0) = pixel64;
-            *(uint64_t*)(ptr + 8) = pixel64;
-            *(uint64_t*)(ptr + 16) = pixel64;
-            *(uint64_t*)(ptr + 24) = pixel64;
-            *(uint64_t*)(ptr + 32) = pixel64;
-            *(uint64_t*)(ptr + 40) = pixel64;
-            *(uint64_t*)(ptr + 48) = pixel64;
-            *(uint64_t*)(ptr + 56) = pixel64;
-            ptr += 64;
-            count -= 64;
+            _mm_storeu_si128((__m128i*)&dest[i], srcPixels);
+            continue;
         }
 
-        while (count >= 8)
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(srcAlpha, zero)) == 0xFFFF)
         {
-            *(uint64_t*)ptr = pixel64;
-            ptr += 8;
-            count -= 8;
+            continue;
         }
 
-        while (count--)
-        {
-            *ptr++ = pixel;
-        }
+        __m128i destPixels = _mm_loadu_si128((const __m128i*)&dest[i]);
+        __m128i low = gfx_blend_premultiplied_wide_sse2(_mm_unpacklo_epi8(srcPixels, zero), _mm_unpacklo_epi8(destPixels, zero));
+        __m128i high =
+            gfx_blend_premultiplied_wide_sse2(_mm_unpackhi_epi8(srcPixels, zero), _mm_unpackhi_epi8(destPixels, zero));
+        _mm_storeu_si128((__m128i*)&dest[i], _mm_packus_epi16(low, high));
     }
-
-    gfx_invalidate(gfx, rect);
+    gfx_blend_premultiplied_scalar(&dest[i], &src[i], count - i);
 }
 
-void gfx_edge(gfx_t* gfx, const rect_t* rect, uint64_t width, pixel_t foreground, pixel_t background)
+__attribute__((target("sse2"))) static void gfx_lerp_sse2(pixel_t* dest, const pixel_t* a, const pixel_t* b,
+    uint32_t weight, uint64_t count)
 {
-    rect_t leftRect = (rect_t){
-        .left = rect->left,
-        .top = rect->top,
-        .right = rect->left + width,
-        .bottom = rect->bottom - width,
-    };
-    gfx_rect(gfx, &leftRect, foreground);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weightA = _mm_set1_epi16(0x100 - weight);
+    const __m128i weightB = _mm_set1_epi16(weight);
 
-    rect_t topRect = (rect_t){
-        .left = rect->left + width,
-        .top = rect->top,
-        .right = rect->right - width,
-        .bottom = rect->top + width,
-    };
-    gfx_rect(gfx, &topRect, foreground);
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i aPixels = _mm_loadu_si128((const __m128i*)&a[i]);
+        __m128i bPixels = _mm_loadu_si128((const __m128i*)&b[i]);
 
-    rect_t rightRect = (rect_t){
-        .left = rect->right - width,
-        .top = rect->top + width,
-        .right = rect->right,
-        .bottom = rect->bottom,
-    };
-    gfx_rect(gfx, &rightRect, background);
+        __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(aPixels, zero), weightA),
+            _mm_mullo_epi16(_mm_unpacklo_epi8(bPixels, zero), weightB));
+        __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(aPixels, zero), weightA),
+            _mm_mullo_epi16(_mm_unpackhi_epi8(bPixels, zero), weightB));
+        _mm_storeu_si128((__m128i*)&dest[i], _mm_packus_epi16(_mm_srli_epi16(low, 8), _mm_srli_epi16(high, 8)));
+    }
+    gfx_lerp_scalar(&dest[i], &a[i], &b[i], weight, count - i);
+}
 
-    rect_t bottomRect = (rect_t){
-        .left = rect->left + width,
-        .top = rect->bottom - width,
-        .right = rect->right - width,
-        .bottom = rect->bottom,
-    };
-    gfx_rect(gfx, &bottomRect, background);
+__attribute__((target("sse2"))) static void gfx_expand_sse2(pixel_t* dest, uint8_t bits, pixel_t foreground,
+    pixel_t background)
+{
+    const __m128i foregroundPixels = _mm_set1_epi32(foreground);
+    const __m128i backgroundPixels = _mm_set1_epi32(background);
+    const __m128i value = _mm_set1_epi32(bits);
 
-    for (uint64_t y = 0; y < width; y++)
+    const __m128i masks[2] = {_mm_setr_epi32(0x80, 0x40, 0x20, 0x10), _mm_setr_epi32(0x08, 0x04, 0x02, 0x01)};
+    for (uint64_t i = 0; i < 2; i++)
     {
-        for (uint64_t x = 0; x < width; x++)
-        {
-            pixel_t color = x + y < width - 1 ? foreground : background;
-            gfx->buffer[(rect->right - width + x) + (rect->top + y) * gfx->stride] = color;
-            gfx->buffer[(rect->left + x) + (rect->bottom - width + y) * gfx->stride] = color;
-        }
+        __m128i set = _mm_cmpeq_epi32(_mm_and_si128(value, masks[i]), masks[i]);
+        __m128i pixels = _mm_or_si128(_mm_and_si128(set, foregroundPixels), _mm_andnot_si128(set, backgroundPixels));
+        _mm_storeu_si128((__m128i*)&dest[i * 4], pixels);
     }
-
-    gfx_invalidate(gfx, rect);
 }
 
-void gfx_ridge(gfx_t* gfx, const rect_t* rect, uint64_t width, pixel_t foreground, pixel_t background)
+static const gfx_pixel_ops_t sse2Ops = {
+    .fill = gfx_fill_sse2,
+    .copy = gfx_copy_sse2,
+    .blend = gfx_blend_sse2,
+    .blendPremultiplied = gfx_blend_premultiplied_sse2,
+    .lerp = gfx_lerp_sse2,
+    .expand = gfx_expand_sse2,
+};
+
+__attribute__((target("avx2"))) static void gfx_fill_avx2(pixel_t* dest, pixel_t pixel, uint64_t count)
 {
-    gfx_edge(gfx, rect, width / 2, background, foreground);
+    __m256i value = _mm256_set1_epi32(pixel);
 
-    rect_t innerRect = *rect;
-    RECT_SHRINK(&innerRect, width / 2);
-    gfx_edge(gfx, &innerRect, width / 2, foreground, background);
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_si256((__m256i*)&dest[i], value);
+    }
+    gfx_fill_sse2(&dest[i], pixel, count - i);
 }
 
-void gfx_rim(gfx_t* gfx, const rect_t* rect, uint64_t width, pixel_t pixel)
+__attribute__((target("avx2"))) static void gfx_copy_avx2(pixel_t* dest, const pixel_t* src, uint64_t count)
 {
-    rect_t leftRect = (rect_t){
-        .left = rect->left,
-        .top = rect->top + width - width / 2,
-        .right = rect->left + width,
-        .bottom = rect->bottom - width + width / 2,
-    };
-    gfx_rect(gfx, &leftRect, pixel);
-
-    rect_t topRect = (rect_t){
-        .left = rect->left + width - width / 2,
-        .top = rect->top,
-        .right = rect->right - width + width / 2,
-        .bottom = rect->top + width,
-    };
-    gfx_rect(gfx, &topRect, pixel);
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_si256((__m256i*)&dest[i], _mm256_loadu_si256((const __m256i*)&src[i]));
+    }
+    gfx_copy_sse2(&dest[i], &src[i], count - i);
+}
 
-    rect_t rightRect = (rect_t){
-        .left = rect->right - width,
-        .top = rect->top + width - width / 2,
-        .right = rect->right,
-        .bottom = rect->bottom - width + width / 2,
-    };
-    gfx_rect(gfx, &rightRect, pixel);
+__attribute__((target("avx2"))) static inline __m256i gfx_blend_wide_avx2(__m256i src, __m256i dest)
+{
+    __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(src, 0xFF), 0xFF);
+    __m256i inverse = _mm256_sub_epi16(_mm256_set1_epi16(0xFF), alpha);
 
-    rect_t bottomRect = (rect_t){
-        .left = rect->left + width - width / 2,
-        .top = rect->bottom - width,
-        .right = rect->right - width + width / 2,
-        .bottom = rect->bottom,
-    };
-    gfx_rect(gfx, &bottomRect, pixel);
+    __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(src, alpha), _mm256_mullo_epi16(dest, inverse));
+    sum = _mm256_add_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(1)), _mm256_srli_epi16(sum, 8));
+    return _mm256_srli_epi16(sum, 8);
 }
 
-void gfx_transfer(gfx_t* dest, const gfx_t* src, const rect_t* destRect, const point_t* srcPoint)
+__attribute__((target("avx2"))) static inline __m256i gfx_blend_premultiplied_wide_avx2(__m256i src, __m256i dest)
 {
-    for (int32_t y = 0; y < RECT_HEIGHT(destRect); y++)
-    {
-        memcpy(&dest->buffer[destRect->left + (y + destRect->top) * dest->stride],
-            &src->buffer[srcPoint->x + (y + srcPoint->y) * src->stride], RECT_WIDTH(destRect) * sizeof(pixel_t));
-    }
+    __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(src, 0xFF), 0xFF);
+    __m256i inverse = _mm256_sub_epi16(_mm256_set1_epi16(0xFF), alpha);
 
-    gfx_invalidate(dest, destRect);
+    __m256i product = _mm256_mullo_epi16(dest, inverse);
+    product = _mm256_add_epi16(_mm256_add_epi16(product, _mm256_set1_epi16(1)), _mm256_srli_epi16(product, 8));
+    return _mm256_add_epi16(src, _mm256_srli_epi16(product, 8));
 }
 
-void gfx_transfer_blend(gfx_t* dest, const gfx_t* src, const rect_t* destRect, const point_t* srcPoint)
+__attribute__((target("avx2"))) static void gfx_blend_avx2(pixel_t* dest, const pixel_t* src, uint64_t count)
 {
-    for (int32_t y = 0; y < RECT_HEIGHT(destRect); y++)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alphaMask = _mm256_set1_epi32(GFX_ALPHA_MASK);
+
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8)
     {
-        for (int32_t x = 0; x < RECT_WIDTH(destRect); x++)
+        __m256i srcPixels = _mm256_loadu_si256((const __m256i*)&src[i]);
+        __m256i destPixels = _mm256_loadu_si256((const __m256i*)&dest[i]);
+
+        __m256i srcAlpha = _mm256_and_si256(srcPixels, alphaMask);
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi32(srcAlpha, alphaMask)) == UINT32_MAX)
         {
-            pixel_t pixel = src->buffer[(srcPoint->x + x) + (srcPoint->y + y) * src->stride];
-            pixel_t* out = &dest->buffer[(destRect->left + x) + (destRect->top + y) * dest->stride];
-            PIXEL_BLEND(out, &pixel);
+            _mm256_storeu_si256((__m256i*)&dest[i], srcPixels);
+            continue;
         }
-    }
 
-    gfx_invalidate(dest, destRect);
-}
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi32(srcAlpha, zero)) == UINT32_MAX)
+        {
+            continue;
+        }
+
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(destPixels, alphaMask), alphaMask)) !=
+            UINT32_MAX)
+        {
+            gfx_blend_scalar(&dest[i], &src[i], 8);
+            continue;
+        }
+
+        // Unpacking and packing both work within 128 bit lanes so the pixel order is preserved.
+        __m256i low = gfx_blend_wide_avx2(_mm256_unpacklo_epi8(srcPixels, zero), _mm256_unpacklo_epi8(destPixels, zero));
+        __m256i high = gfx_blend_wide_avx2(_mm256_unpackhi_epi8(srcPixels, zero), _mm256_unpackhi_epi8(destPixels, zero));
+        _mm256_storeu_si256((__m256i*)&dest[i], _mm256_or_si256(_mm256_packus_epi16(low, high), alphaMask));
+    }
+    gfx_blend_sse2(&dest[i], &src[i], count - i);
+}
+
+__attribute__((target("avx2"))) static void gfx_blend_premultiplied_avx2(pixel_t* dest, const pixel_t* src,
+    uint64_t count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alphaMask = _mm256_set1_epi32(GFX_ALPHA_MASK);
+
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i srcPixels = _mm256_loadu_si256((const __m256i*)&src[i]);
+
+        __m256i srcAlpha = _mm256_and_si256(srcPixels, alphaMask);
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi32(srcAlpha, alphaMask)) == UINT32_MAX)
+        {
+            _mm256_storeu_si256((__m256i*)&dest[i], srcPixels);
+            continue;
+        }
+
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi32(srcAlpha, zero)) == UINT32_MAX)
+        {
+            continue;
+        }
+
+        __m256i destPixels = _mm256_loadu_si256((const __m256i*)&dest[i]);
+        __m256i low =
+            gfx_blend_premultiplied_wide_avx2(_mm256_unpacklo_epi8(srcPixels, zero), _mm256_unpacklo_epi8(destPixels, zero));
+        __m256i high =
+            gfx_blend_premultiplied_wide_avx2(_mm256_unpackhi_epi8(srcPixels, zero), _mm256_unpackhi_epi8(destPixels, zero));
+        _mm256_storeu_si256((__m256i*)&dest[i], _mm256_packus_epi16(low, high));
+    }
+    gfx_blend_premultiplied_sse2(&dest[i], &src[i], count - i);
+}
+
+__attribute__((target("avx2"))) static void gfx_lerp_avx2(pixel_t* dest, const pixel_t* a, const pixel_t* b,
+    uint32_t weight, uint64_t count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i weightA = _mm256_set1_epi16(0x100 - weight);
+    const __m256i weightB = _mm256_set1_epi16(weight);
+
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i aPixels = _mm256_loadu_si256((const __m256i*)&a[i]);
+        __m256i bPixels = _mm256_loadu_si256((const __m256i*)&b[i]);
+
+        __m256i low = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(aPixels, zero), weightA),
+            _mm256_mullo_epi16(_mm256_unpacklo_epi8(bPixels, zero), weightB));
+        __m256i high = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(aPixels, zero), weightA),
+            _mm256_mullo_epi16(_mm256_unpackhi_epi8(bPixels, zero), weightB));
+        _mm256_storeu_si256((__m256i*)&dest[i],
+            _mm256_packus_epi16(_mm256_srli_epi16(low, 8), _mm256_srli_epi16(high, 8)));
+    }
+    gfx_lerp_sse2(&dest[i], &a[i], &b[i], weight, count - i);
+}
+
+__attribute__((target("avx2"))) static void gfx_expand_avx2(pixel_t* dest, uint8_t bits, pixel_t foreground,
+    pixel_t background)
+{
+    const __m256i masks = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+    __m256i set = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(bits), masks), masks);
+    __m256i pixels = _mm256_blendv_epi8(_mm256_set1_epi32(background), _mm256_set1_epi32(foreground), set);
+    _mm256_storeu_si256((__m256i*)dest, pixels);
+}
+
+static const gfx_pixel_ops_t avx2Ops = {
+    .fill = gfx_fill_avx2,
+    .copy = gfx_copy_avx2,
+    .blend = gfx_blend_avx2,
+    .blendPremultiplied = gfx_blend_premultiplied_avx2,
+    .lerp = gfx_lerp_avx2,
+    .expand = gfx_expand_avx2,
+};
+
+__attribute__((target("avx512f"))) static void gfx_fill_avx512(pixel_t* dest, pixel_t pixel, uint64_t count)
+{
+    __m512i value = _mm512_set1_epi32(pixel);
+
+    uint64_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        _mm512_storeu_si512(&dest[i], value);
+    }
+    gfx_fill_avx2(&dest[i], pixel, count - i);
+}
+
+__attribute__((target("avx512f"))) static void gfx_copy_avx512(pixel_t* dest, const pixel_t* src, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        _mm512_storeu_si512(&dest[i], _mm512_loadu_si512(&src[i]));
+    }
+    gfx_copy_avx2(&dest[i], &src[i], count - i);
+}
+
+// Avx512f has no 16 bit multiply so each channel is blended in its own 32 bit lanes.
+__attribute__((target("avx512f"))) static void gfx_blend_avx512(pixel_t* dest, const pixel_t* src, uint64_t count)
+{
+    const __m512i alphaMask = _mm512_set1_epi32(GFX_ALPHA_MASK);
+    const __m512i channelMask = _mm512_set1_epi32(0xFF);
+    const __m512i one = _mm512_set1_epi32(1);
+
+    uint64_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512i srcPixels = _mm512_loadu_si512(&src[i]);
+        __m512i destPixels = _mm512_loadu_si512(&dest[i]);
+
+        __m512i srcAlpha = _mm512_and_si512(srcPixels, alphaMask);
+        if (_mm512_cmpeq_epi32_mask(srcAlpha, alphaMask) == 0xFFFF)
+        {
+            _mm512_storeu_si512(&dest[i], srcPixels);
+            continue;
+        }
+
+        if (_mm512_cmpeq_epi32_mask(srcAlpha, _mm512_setzero_si512()) == 0xFFFF)
+        {
+            continue;
+        }
+
+        if (_mm512_cmpeq_epi32_mask(_mm512_and_si512(destPixels, alphaMask), alphaMask) != 0xFFFF)
+        {
+            gfx_blend_scalar(&dest[i], &src[i], 16);
+            continue;
+        }
+
+        __m512i alpha = _mm512_srli_epi32(srcPixels, 24);
+        __m512i inverse = _mm512_sub_epi32(channelMask, alpha);
+
+        __m512i result = alphaMask;
+        for (uint64_t shift = 0; shift < 24; shift += 8)
+        {
+            __m512i srcChannel = _mm512_and_si512(_mm512_srli_epi32(srcPixels, shift), channelMask);
+            __m512i destChannel = _mm512_and_si512(_mm512_srli_epi32(destPixels, shift), channelMask);
+
+            __m512i sum = _mm512_add_epi32(_mm512_mullo_epi32(srcChannel, alpha), _mm512_mullo_epi32(destChannel, inverse));
+            sum = _mm512_srli_epi32(_mm512_add_epi32(_mm512_add_epi32(sum, one), _mm512_srli_epi32(sum, 8)), 8);
+            result = _mm512_or_si512(result, _mm512_slli_epi32(sum, shift));
+        }
+        _mm512_storeu_si512(&dest[i], result);
+    }
+    gfx_blend_avx2(&dest[i], &src[i], count - i);
+}
+
+static const gfx_pixel_ops_t avx512Ops = {
+    .fill = gfx_fill_avx512,
+    .copy = gfx_copy_avx512,
+    .blend = gfx_blend_avx512,
+    .blendPremultiplied = gfx_blend_premultiplied_avx2,
+    .lerp = gfx_lerp_avx2,
+    .expand = gfx_expand_avx2,
+};
+
+static uint32_t gfx_cpuid(uint32_t leaf, uint32_t* ebx, uint32_t* ecx, uint32_t* edx)
+{
+    uint32_t eax;
+    asm volatile("cpuid" : "=a"(eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(0));
+    return eax;
+}
+
+static uint64_t gfx_xcr0(void)
+{
+    uint32_t eax;
+    uint32_t edx;
+    asm volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+}
+
+static const gfx_pixel_ops_t* gfx_pixel_ops_select(void)
+{
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+    uint32_t maxLeaf = gfx_cpuid(0, &ebx, &ecx, &edx);
+    gfx_cpuid(1, &ebx, &ecx, &edx);
+    if (!(edx & GFX_CPUID_EDX_SSE2))
+    {
+        return &scalarOps;
+    }
+
+    // The vector state must also be enabled by the os, not just supported by the cpu.
+    if (!(ecx & GFX_CPUID_ECX_OSXSAVE) || !(ecx & GFX_CPUID_ECX_AVX) || (gfx_xcr0() & GFX_XCR0_AVX) != GFX_XCR0_AVX)
+    {
+        return &sse2Ops;
+    }
+
+    if (maxLeaf < 7)
+    {
+        return &sse2Ops;
+    }
+
+    gfx_cpuid(7, &ebx, &ecx, &edx);
+    if ((ebx & GFX_CPUID_EBX_AVX512F) && (ebx & GFX_CPUID_EBX_AVX2) &&
+        (gfx_xcr0() & GFX_XCR0_AVX512) == GFX_XCR0_AVX512)
+    {
+        return &avx512Ops;
+    }
+
+    return (ebx & GFX_CPUID_EBX_AVX2) ? &avx2Ops : &sse2Ops;
+}
+
+static const gfx_pixel_ops_t* gfx_pixel_ops(void)
+{
+    static const gfx_pixel_ops_t* ops = NULL;
+    if (ops == NULL)
+    {
+        ops = gfx_pixel_ops_select();
+    }
+
+    return ops;
+}
+
+static pixel_t gfx_unpremultiply(pixel_t pixel)
+{
+    uint8_t alpha = PIXEL_ALPHA(pixel);
+    if (alpha == 0xFF || alpha == 0)
+    {
+        return pixel;
+    }
+
+    return PIXEL_ARGB(alpha, PIXEL_RED(pixel) * 0xFF / alpha, PIXEL_GREEN(pixel) * 0xFF / alpha,
+        PIXEL_BLUE(pixel) * 0xFF / alpha);
+}
+
+static pixel_t gfx_premultiply_pixel(pixel_t pixel)
+{
+    uint32_t alpha = PIXEL_ALPHA(pixel);
+    if (alpha == 0xFF)
+    {
+        return pixel;
+    }
+
+    return PIXEL_ARGB(alpha, GFX_DIV255(PIXEL_RED(pixel) * alpha), GFX_DIV255(PIXEL_GREEN(pixel) * alpha),
+        GFX_DIV255(PIXEL_BLUE(pixel) * alpha));
+}
+
+// Returns the conversion needed to draw pixels of an image into gfx, or NULL if the formats already match.
+static pixel_t (*gfx_convert_get(const gfx_t* gfx, bool premultiplied))(pixel_t)
+{
+    if (premultiplied == ((gfx->flags & GFX_PREMULTIPLIED) != 0))
+    {
+        return NULL;
+    }
+
+    return premultiplied ? gfx_unpremultiply : gfx_premultiply_pixel;
+}
+
+// Writes count pixels starting at (x, y) of the image, clipped to clip which is in destination coordinates.
+static void gfx_fbmp2_span(gfx_t* gfx, const rect_t* clip, const point_t* point, int64_t x, int64_t y, const pixel_t* src,
+    uint64_t count, bool run, pixel_t (*convert)(pixel_t))
+{
+    int64_t destY = point->y + y;
+    int64_t left = MAX(point->x + x, clip->left);
+    int64_t right = MIN(point->x + x + (int64_t)count, clip->right);
+    if (destY < clip->top || destY >= clip->bottom || left >= right)
+    {
+        return;
+    }
+
+    pixel_t* dest = &gfx->buffer[left + destY * gfx->stride];
+    const gfx_pixel_ops_t* ops = gfx_pixel_ops();
+    if (run)
+    {
+        ops->fill(dest, convert != NULL ? convert(*src) : *src, right - left);
+    }
+    else if (convert != NULL)
+    {
+        src += left - (point->x + x);
+        for (int64_t i = 0; i < right - left; i++)
+        {
+            dest[i] = convert(src[i]);
+        }
+    }
+    else
+    {
+        ops->copy(dest, src + (left - (point->x + x)), right - left);
+    }
+}
+
+static void gfx_fbmp2_tile(gfx_t* gfx, const gfx_fbmp2_t* fbmp2, const rect_t* clip, const point_t* point,
+    const rect_t* tileRect, uint32_t tile)
+{
+    const uint8_t* data = (const uint8_t*)fbmp2 + fbmp2->offsets[tile];
+    const uint8_t* end = (const uint8_t*)fbmp2 + fbmp2->offsets[tile + 1];
+    pixel_t (*convert)(pixel_t) = gfx_convert_get(gfx, fbmp2->flags & FBMP2_PREMULTIPLIED);
+
+    uint64_t width = RECT_WIDTH(tileRect);
+    uint64_t pixelAmount = width * RECT_HEIGHT(tileRect);
+    uint64_t index = 0;
+    while (index < pixelAmount && data + sizeof(uint32_t) <= end)
+    {
+        uint32_t packet = *(const uint32_t*)data;
+        data += sizeof(uint32_t);
+
+        bool run = packet & FBMP2_RUN;
+        uint64_t count = MIN(packet & ~FBMP2_RUN, pixelAmount - index);
+        const pixel_t* src = (const pixel_t*)data;
+        uint64_t dataSize = (run ? 1 : count) * sizeof(pixel_t);
+        if (data + dataSize > end)
+        {
+            return;
+        }
+        data += dataSize;
+
+        // Packets may span several rows of the tile, they are split into one span per row.
+        while (count != 0)
+        {
+            uint64_t x = index % width;
+            uint64_t y = index / width;
+            if (tileRect->top + (int64_t)y + point->y >= clip->bottom)
+            {
+                return;
+            }
+
+            uint64_t spanCount = MIN(count, width - x);
+            gfx_fbmp2_span(gfx, clip, point, tileRect->left + x, tileRect->top + y, src, spanCount, run, convert);
+
+            if (!run)
+            {
+                src += spanCount;
+            }
+            index += spanCount;
+            count -= spanCount;
+        }
+    }
+}
+
+void gfx_fbmp(gfx_t* gfx, const gfx_fbmp_t* fbmp, const point_t* point)
+{
+    rect_t bounds = RECT_INIT_GFX(gfx);
+    rect_t clip = RECT_INIT_DIM(point->x, point->y, fbmp->width, fbmp->height);
+    RECT_FIT(&clip, &bounds);
+    if (RECT_WIDTH(&clip) <= 0 || RECT_HEIGHT(&clip) <= 0)
+    {
+        return;
+    }
+
+    if (fbmp->magic == FBMP2_MAGIC)
+    {
+        // Only tiles overlapping the clipped destination are decoded, straight into the destination.
+        const gfx_fbmp2_t* fbmp2 = (const gfx_fbmp2_t*)fbmp;
+        uint32_t tileSize = fbmp2->tileSize;
+        uint32_t columns = (fbmp2->width + tileSize - 1) / tileSize;
+        uint32_t firstColumn = (clip.left - point->x) / tileSize;
+        uint32_t lastColumn = (clip.right - 1 - point->x) / tileSize;
+        uint32_t firstRow = (clip.top - point->y) / tileSize;
+        uint32_t lastRow = (clip.bottom - 1 - point->y) / tileSize;
+
+        for (uint32_t row = firstRow; row <= lastRow; row++)
+        {
+            for (uint32_t column = firstColumn; column <= lastColumn; column++)
+            {
+                rect_t tileRect = RECT_INIT_DIM(column * tileSize, row * tileSize,
+                    MIN(tileSize, fbmp2->width - column * tileSize), MIN(tileSize, fbmp2->height - row * tileSize));
+                gfx_fbmp2_tile(gfx, fbmp2, &clip, point, &tileRect, column + row * columns);
+            }
+        }
+    }
+    else
+    {
+        pixel_t (*convert)(pixel_t) = gfx_convert_get(gfx, false);
+        const gfx_pixel_ops_t* ops = gfx_pixel_ops();
+        for (int64_t y = clip.top; y < clip.bottom; y++)
+        {
+            pixel_t* dest = &gfx->buffer[clip.left + y * gfx->stride];
+            const pixel_t* src = &fbmp->data[(clip.left - point->x) + (y - point->y) * fbmp->width];
+            if (convert == NULL)
+            {
+                ops->copy(dest, src, RECT_WIDTH(&clip));
+                continue;
+            }
+
+            for (int64_t i = 0; i < RECT_WIDTH(&clip); i++)
+            {
+                dest[i] = convert(src[i]);
+            }
+        }
+    }
+
+    gfx_invalidate(gfx, &clip);
+}
+
+#define GFX_GLYPH_CACHE_SETS 8
+
+// Glyphs are expanded to pixels once per font, scale and color pair, drawing is then a copy or blend per row.
+typedef struct
+{
+    uint64_t scale;
+    pixel_t foreground;
+    pixel_t background;
+    uint64_t lastUsed;
+    pixel_t** glyphs;
+} gfx_glyph_set_t;
+
+typedef struct gfx_glyph_cache
+{
+    gfx_glyph_set_t sets[GFX_GLYPH_CACHE_SETS];
+    uint64_t time;
+} gfx_glyph_cache_t;
+
+static void gfx_glyph_set_clear(const gfx_psf_t* psf, gfx_glyph_set_t* set)
+{
+    if (set->glyphs == NULL)
+    {
+        return;
+    }
+
+    for (uint64_t i = 0; i < psf->glyphAmount; i++)
+    {
+        free(set->glyphs[i]);
+    }
+    free(set->glyphs);
+    set->glyphs = NULL;
+}
+
+static void gfx_glyph_cache_free(gfx_psf_t* psf)
+{
+    if (psf->cache == NULL)
+    {
+        return;
+    }
+
+    for (uint64_t i = 0; i < GFX_GLYPH_CACHE_SETS; i++)
+    {
+        gfx_glyph_set_clear(psf, &psf->cache->sets[i]);
+    }
+    free(psf->cache);
+    psf->cache = NULL;
+}
+
+static gfx_glyph_set_t* gfx_glyph_set_get(gfx_psf_t* psf, uint64_t scale, pixel_t foreground, pixel_t background)
+{
+    if (psf->cache == NULL)
+    {
+        psf->cache = calloc(1, sizeof(gfx_glyph_cache_t));
+        if (psf->cache == NULL)
+        {
+            return NULL;
+        }
+    }
+    gfx_glyph_cache_t* cache = psf->cache;
+    cache->time++;
+
+    gfx_glyph_set_t* victim = &cache->sets[0];
+    for (uint64_t i = 0; i < GFX_GLYPH_CACHE_SETS; i++)
+    {
+        gfx_glyph_set_t* set = &cache->sets[i];
+        if (set->glyphs != NULL && set->scale == scale && set->foreground == foreground && set->background == background)
+        {
+            set->lastUsed = cache->time;
+            return set;
+        }
+
+        if (victim->glyphs != NULL && (set->glyphs == NULL || set->lastUsed < victim->lastUsed))
+        {
+            victim = set;
+        }
+    }
+
+    gfx_glyph_set_clear(psf, victim);
+    victim->glyphs = calloc(psf->glyphAmount, sizeof(pixel_t*));
+    if (victim->glyphs == NULL)
+    {
+        return NULL;
+    }
+    victim->scale = scale;
+    victim->foreground = foreground;
+    victim->background = background;
+    victim->lastUsed = cache->time;
+    return victim;
+}
+
+static const pixel_t* gfx_glyph_get(const gfx_psf_t* psf, gfx_glyph_set_t* set, uint8_t chr)
+{
+    if (chr >= psf->glyphAmount)
+    {
+        return NULL;
+    }
+
+    if (set->glyphs[chr] != NULL)
+    {
+        return set->glyphs[chr];
+    }
+
+    uint64_t width = psf->width * set->scale;
+    pixel_t* glyph = malloc(width * psf->height * set->scale * sizeof(pixel_t));
+    if (glyph == NULL)
+    {
+        return NULL;
+    }
+
+    const gfx_pixel_ops_t* ops = gfx_pixel_ops();
+    uint64_t rowSize = (psf->width + 7) / 8;
+    for (uint64_t y = 0; y < psf->height; y++)
+    {
+        const uint8_t* bits = psf->glyphs + chr * psf->glyphSize + y * rowSize;
+        pixel_t* row = &glyph[y * set->scale * width];
+
+        if (set->scale == 1 && psf->width % 8 == 0)
+        {
+            for (uint64_t i = 0; i < rowSize; i++)
+            {
+                ops->expand(&row[i * 8], bits[i], set->foreground, set->background);
+            }
+        }
+        else
+        {
+            for (uint64_t bit = 0; bit < psf->width; bit++)
+            {
+                pixel_t pixel = (bits[bit / 8] & (0b10000000 >> (bit % 8))) != 0 ? set->foreground : set->background;
+                ops->fill(&row[bit * set->scale], pixel, set->scale);
+            }
+        }
+
+        for (uint64_t i = 1; i < set->scale; i++)
+        {
+            ops->copy(&row[i * width], row, width);
+        }
+    }
+
+    set->glyphs[chr] = glyph;
+    return glyph;
+}
+
+static void gfx_glyph_row(gfx_t* gfx, const gfx_glyph_set_t* set, const pixel_t* glyph, uint64_t width, int64_t x,
+    int64_t y, uint64_t row)
+{
+    const gfx_pixel_ops_t* ops = gfx_pixel_ops();
+    pixel_t* out = &gfx->buffer[x + y * gfx->stride];
+
+    if (PIXEL_ALPHA(set->foreground) == 0xFF && PIXEL_ALPHA(set->background) == 0xFF)
+    {
+        ops->copy(out, &glyph[row * width], width);
+    }
+    else
+    {
+        ops->blend(out, &glyph[row * width], width);
+    }
+}
+
+void gfx_psf_char(gfx_t* gfx, gfx_psf_t* psf, const point_t* point, uint64_t height, char chr, pixel_t foreground,
+    pixel_t background)
+{
+    uint64_t scale = MAX(1, height / psf->height);
+    gfx_glyph_set_t* set = gfx_glyph_set_get(psf, scale, foreground, background);
+    if (set == NULL)
+    {
+        return;
+    }
+
+    const pixel_t* glyph = gfx_glyph_get(psf, set, chr);
+    if (glyph == NULL)
+    {
+        return;
+    }
+
+    uint64_t width = psf->width * scale;
+    for (uint64_t y = 0; y < psf->height * scale; y++)
+    {
+        gfx_glyph_row(gfx, set, glyph, width, point->x, point->y + y, y);
+    }
+}
+
+// Places str within rect, cutting it short with three dots if it does not fit, the result is the rect the text covers.
+static bool gfx_psf_layout(const gfx_psf_t* psf, const rect_t* rect, gfx_align_t xAlign, gfx_align_t yAlign,
+    uint64_t height, const char* str, rect_t* textRect, uint64_t* scale, uint64_t* amount, uint64_t* dots)
+{
+    *scale = MAX(1, height / psf->height);
+    height = psf->height * *scale;
+    uint64_t glyphWidth = psf->width * *scale;
+    int64_t width = strlen(str) * glyphWidth;
+
+    point_t point;
+    switch (xAlign)
+    {
+    case GFX_CENTER:
+    {
+        point.x = MAX(rect->left, (rect->right + rect->left - width) / 2);
+    }
+    break;
+    case GFX_MAX:
+    {
+        point.x = MAX(rect->left, rect->right - width);
+    }
+    break;
+    case GFX_MIN:
+    {
+        point.x = rect->left;
+    }
+    break;
+    default:
+    {
+        return false;
+    }
+    }
+
+    switch (yAlign)
+    {
+    case GFX_CENTER:
+    {
+        point.y = MAX(rect->top, (rect->bottom + rect->top - (int64_t)height) / 2);
+    }
+    break;
+    case GFX_MAX:
+    {
+        point.y = MAX(rect->top, rect->bottom - (int64_t)height);
+    }
+    break;
+    case GFX_MIN:
+    {
+        point.y = rect->top;
+    }
+    break;
+    default:
+    {
+        return false;
+    }
+    }
+
+    *amount = strlen(str);
+    *dots = 0;
+    if (RECT_WIDTH(rect) < width)
+    {
+        uint64_t fit = RECT_WIDTH(rect) / glyphWidth;
+        *dots = MIN(fit, 3);
+        *amount = fit - *dots;
+    }
+
+    *textRect = RECT_INIT_DIM(point.x, point.y, (*amount + *dots) * glyphWidth, height);
+    return true;
+}
+
+// Draws the rows first to last of a string laid out by gfx_psf_layout(), one screen row at a time.
+static void gfx_psf_rows(gfx_t* gfx, gfx_psf_t* psf, const rect_t* textRect, uint64_t scale, const char* str,
+    uint64_t amount, uint64_t dots, pixel_t foreground, pixel_t background, uint64_t first, uint64_t last)
+{
+    gfx_glyph_set_t* set = gfx_glyph_set_get(psf, scale, foreground, background);
+    if (set == NULL)
+    {
+        return;
+    }
+
+    const pixel_t* dot = gfx_glyph_get(psf, set, '.');
+    for (uint64_t i = 0; i < amount; i++)
+    {
+        gfx_glyph_get(psf, set, str[i]);
+    }
+
+    uint64_t glyphWidth = psf->width * scale;
+    for (uint64_t y = first; y < last; y++)
+    {
+        int64_t x = textRect->left;
+        for (uint64_t i = 0; i < amount + dots; i++)
+        {
+            uint8_t chr = str[i];
+            const pixel_t* glyph = i >= amount ? dot : (chr < psf->glyphAmount ? set->glyphs[chr] : NULL);
+            if (glyph != NULL)
+            {
+                gfx_glyph_row(gfx, set, glyph, glyphWidth, x, textRect->top + y, y);
+            }
+            x += glyphWidth;
+        }
+    }
+}
+
+void gfx_psf(gfx_t* gfx, gfx_psf_t* psf, const rect_t* rect, gfx_align_t xAlign, gfx_align_t yAlign, uint64_t height,
+    const char* str, pixel_t foreground, pixel_t background)
+{
+    rect_t textRect;
+    uint64_t scale;
+    uint64_t amount;
+    uint64_t dots;
+    if (!gfx_psf_layout(psf, rect, xAlign, yAlign, height, str, &textRect, &scale, &amount, &dots))
+    {
+        return;
+    }
+
+    gfx_psf_rows(gfx, psf, &textRect, scale, str, amount, dots, foreground, background, 0, RECT_HEIGHT(&textRect));
+    gfx_invalidate(gfx, &textRect);
+}
+
+void gfx_rect(gfx_t* gfx, const rect_t* rect, pixel_t pixel)
+{
+    const gfx_pixel_ops_t* ops = gfx_pixel_ops();
+    for (int64_t y = rect->top; y < rect->bottom; y++)
+    {
+        ops->fill(&gfx->buffer[rect->left + y * gfx->stride], pixel, RECT_WIDTH(rect));
+    }
+
+    gfx_invalidate(gfx, rect);
+}
+
+// Draws row y of an edge as spans, in the same order the parts of the edge overlap. The two corners where the colors
+// meet are split along the diagonal.
+static void gfx_edge_row(gfx_t* gfx, const rect_t* rect, int64_t width, pixel_t foreground, pixel_t background, int64_t y)
+{
+    const gfx_pixel_ops_t* ops = gfx_pixel_ops();
+    pixel_t* row = &gfx->buffer[y * gfx->stride];
+    int64_t inner = MAX(0, RECT_WIDTH(rect) - 2 * width);
+
+    if (y < rect->bottom - width)
+    {
+        ops->fill(&row[rect->left], foreground, width);
+    }
+    if (y < rect->top + width)
+    {
+        ops->fill(&row[rect->left + width], foreground, inner);
+    }
+    else
+    {
+        ops->fill(&row[rect->right - width], background, width);
+    }
+    if (y >= rect->bottom - width)
+    {
+        ops->fill(&row[rect->left + width], background, inner);
+    }
+
+    if (y < rect->top + width)
+    {
+        int64_t split = width - 1 - (y - rect->top);
+        ops->fill(&row[rect->right - width], foreground, split);
+        ops->fill(&row[rect->right - width + split], background, width - split);
+    }
+    if (y >= rect->bottom - width)
+    {
+        int64_t split = width - 1 - (y - (rect->bottom - width));
+        ops->fill(&row[rect->left], foreground, split);
+        ops->fill(&row[rect->left + split], background, width - split);
+    }
+}
+
+void gfx_edge(gfx_t* gfx, const rect_t* rect, uint64_t width, pixel_t foreground, pixel_t background)
+{
+    for (int64_t y = rect->top; y < rect->bottom; y++)
+    {
+        gfx_edge_row(gfx, rect, width, foreground, background, y);
+    }
+
+    gfx_invalidate(gfx, rect);
+}
+
+void gfx_ridge(gfx_t* gfx, const rect_t* rect, uint64_t width, pixel_t foreground, pixel_t background)
+{
+    gfx_edge(gfx, rect, width / 2, background, foreground);
+
+    rect_t innerRect = *rect;
+    RECT_SHRINK(&innerRect, width / 2);
+    gfx_edge(gfx, &innerRect, width / 2, foreground, background);
+}
+
+void gfx_rim(gfx_t* gfx, const rect_t* rect, uint64_t width, pixel_t pixel)
+{
+    rect_t leftRect = (rect_t){
+        .left = rect->left,
+        .top = rect->top + width - width / 2,
+        .right = rect->left + width,
+        .bottom = rect->bottom - width + width / 2,
+    };
+    gfx_rect(gfx, &leftRect, pixel);
+
+    rect_t topRect = (rect_t){
+        .left = rect->left + width - width / 2,
+        .top = rect->top,
+        .right = rect->right - width + width / 2,
+        .bottom = rect->top + width,
+    };
+    gfx_rect(gfx, &topRect, pixel);
+
+    rect_t rightRect = (rect_t){
+        .left = rect->right - width,
+        .top = rect->top + width - width / 2,
+        .right = rect->right,
+        .bottom = rect->bottom - width + width / 2,
+    };
+    gfx_rect(gfx, &rightRect, pixel);
+
+    rect_t bottomRect = (rect_t){
+        .left = rect->left + width - width / 2,
+        .top = rect->bottom - width,
+        .right = rect->right - width + width / 2,
+        .bottom = rect->bottom,
+    };
+    gfx_rect(gfx, &bottomRect, pixel);
+}
+
+void gfx_transfer(gfx_t* dest, const gfx_t* src, const rect_t* destRect, const point_t* srcPoint)
+{
+    const gfx_pixel_ops_t* ops = gfx_pixel_ops();
+    for (int32_t y = 0; y < RECT_HEIGHT(destRect); y++)
+    {
+        ops->copy(&dest->buffer[destRect->left + (y + destRect->top) * dest->stride],
+            &src->buffer[srcPoint->x + (y + srcPoint->y) * src->stride], RECT_WIDTH(destRect));
+    }
+
+    gfx_invalidate(dest, destRect);
+}
+
+void gfx_transfer_blend(gfx_t* dest, const gfx_t* src, const rect_t* destRect, const point_t* srcPoint)
+{
+    if (src->flags & GFX_OPAQUE)
+    {
+        gfx_transfer(dest, src, destRect, srcPoint);
+        return;
+    }
+
+    const gfx_pixel_ops_t* ops = gfx_pixel_ops();
+    void (*blend)(pixel_t*, const pixel_t*, uint64_t) = src->flags & GFX_PREMULTIPLIED ? ops->blendPremultiplied : ops->blend;
+    for (int32_t y = 0; y < RECT_HEIGHT(destRect); y++)
+    {
+        blend(&dest->buffer[destRect->left + (y + destRect->top) * dest->stride],
+            &src->buffer[srcPoint->x + (y + srcPoint->y) * src->stride], RECT_WIDTH(destRect));
+    }
+
+    gfx_invalidate(dest, destRect);
+}
 
 void gfx_swap(gfx_t* dest, const gfx_t* src, const rect_t* rect)
 {
+    const gfx_pixel_ops_t* ops = gfx_pixel_ops();
     for (int32_t y = 0; y < RECT_HEIGHT(rect); y++)
     {
-        uint64_t offset = (rect->left * sizeof(pixel_t)) + (y + rect->top) * sizeof(pixel_t) * dest->stride;
-
-        memcpy((void*)((uint64_t)dest->buffer + offset), (void*)((uint64_t)src->buffer + offset),
-            RECT_WIDTH(rect) * sizeof(pixel_t));
+        uint64_t offset = rect->left + (y + rect->top) * dest->stride;
+        ops->copy(&dest->buffer[offset], &src->buffer[offset], RECT_WIDTH(rect));
     }
 
     gfx_invalidate(dest, rect);
 }
 
+typedef struct
+{
+    uint32_t index;
+    uint32_t next;
+    uint32_t weight;
+} gfx_scale_step_t;
+
+// Maps the destination positions first to first + amount of a destSize long axis onto a srcSize long axis, sampling at
+// pixel centers in 16.16 fixed point so the only division is the one computing the step.
+static void gfx_scale_steps(gfx_scale_step_t* steps, int64_t first, uint64_t amount, uint32_t destSize, uint32_t srcSize,
+    gfx_filter_t filter)
+{
+    int64_t step = ((int64_t)srcSize << 16) / destSize;
+    int64_t position = step / 2 + first * step - (filter == GFX_BILINEAR ? 0x8000 : 0);
+    int64_t last = (int64_t)(srcSize - 1) << 16;
+
+    for (uint64_t i = 0; i < amount; i++)
+    {
+        int64_t clamped = CLAMP(position, 0, last);
+        steps[i].index = clamped >> 16;
+        steps[i].next = MIN(steps[i].index + 1, srcSize - 1);
+        steps[i].weight = filter == GFX_BILINEAR ? (clamped >> 8) & 0xFF : 0;
+        position += step;
+    }
+}
+
+// Scales srcRect of src to fill destRect of dest, which is clipped to dest. Bilinear rows are first interpolated
+// vertically into a line buffer and then horizontally, destination rows that sample the same source rows are copied.
+void gfx_scale(gfx_t* dest, const gfx_t* src, const rect_t* destRect, const rect_t* srcRect, gfx_filter_t filter)
+{
+    rect_t srcBounds = RECT_INIT_GFX(src);
+    rect_t source = *srcRect;
+    RECT_FIT(&source, &srcBounds);
+    rect_t destBounds = RECT_INIT_GFX(dest);
+    rect_t clip = *destRect;
+    RECT_FIT(&clip, &destBounds);
+    if (RECT_WIDTH(&source) <= 0 || RECT_HEIGHT(&source) <= 0 || RECT_WIDTH(&clip) <= 0 || RECT_HEIGHT(&clip) <= 0)
+    {
+        return;
+    }
+
+    uint64_t width = RECT_WIDTH(&clip);
+    uint64_t height = RECT_HEIGHT(&clip);
+    uint64_t srcWidth = RECT_WIDTH(&source);
+    uint64_t lineSize = filter == GFX_BILINEAR ? srcWidth * sizeof(pixel_t) : 0;
+    gfx_scale_step_t* columns = malloc((width + height) * sizeof(gfx_scale_step_t) + lineSize);
+    if (columns == NULL)
+    {
+        return;
+    }
+    gfx_scale_step_t* rows = &columns[width];
+    pixel_t* line = (pixel_t*)&rows[height];
+
+    gfx_scale_steps(columns, clip.left - destRect->left, width, RECT_WIDTH(destRect), srcWidth, filter);
+    gfx_scale_steps(rows, clip.top - destRect->top, height, RECT_HEIGHT(destRect), RECT_HEIGHT(&source), filter);
+
+    // Only the part of the line buffer that the columns sample from is interpolated.
+    uint32_t first = columns[0].index;
+    uint32_t last = columns[width - 1].next;
+
+    const gfx_pixel_ops_t* ops = gfx_pixel_ops();
+    for (uint64_t y = 0; y < height; y++)
+    {
+        pixel_t* out = &dest->buffer[clip.left + (clip.top + y) * dest->stride];
+        if (y != 0 && rows[y].index == rows[y - 1].index && rows[y].weight == rows[y - 1].weight)
+        {
+            ops->copy(out, out - dest->stride, width);
+            continue;
+        }
+
+        const pixel_t* top = &src->buffer[source.left + (source.top + rows[y].index) * src->stride];
+        if (filter == GFX_BILINEAR)
+        {
+            const pixel_t* bottom = &src->buffer[source.left + (source.top + rows[y].next) * src->stride];
+            ops->lerp(&line[first], &top[first], &bottom[first], rows[y].weight, last - first + 1);
+
+            for (uint64_t x = 0; x < width; x++)
+            {
+                out[x] = gfx_lerp_pixel(line[columns[x].index], line[columns[x].next], columns[x].weight);
+            }
+        }
+        else
+        {
+            for (uint64_t x = 0; x < width; x++)
+            {
+                out[x] = top[columns[x].index];
+            }
+        }
+    }
+
+    free(columns);
+    gfx_invalidate(dest, &clip);
+}
+
+const gfx_t* gfx_scaled_get(gfx_scaled_t* scaled, const gfx_t* src, uint32_t width, uint32_t height, gfx_filter_t filter)
+{
+    if (scaled->gfx.buffer != NULL && scaled->source == src->buffer && scaled->sourceWidth == src->width &&
+        scaled->sourceHeight == src->height && scaled->gfx.width == width && scaled->gfx.height == height &&
+        scaled->filter == filter)
+    {
+        return &scaled->gfx;
+    }
+
+    if (scaled->gfx.buffer == NULL || scaled->gfx.width != width || scaled->gfx.height != height)
+    {
+        pixel_t* buffer = malloc((uint64_t)width * height * sizeof(pixel_t));
+        if (buffer == NULL)
+        {
+            return NULL;
+        }
+
+        free(scaled->gfx.buffer);
+        scaled->gfx.buffer = buffer;
+        scaled->gfx.width = width;
+        scaled->gfx.height = height;
+        scaled->gfx.stride = width;
+    }
+    scaled->gfx.flags = src->flags;
+    scaled->source = src->buffer;
+    scaled->sourceWidth = src->width;
+    scaled->sourceHeight = src->height;
+    scaled->filter = filter;
+
+    rect_t destRect = RECT_INIT_GFX(&scaled->gfx);
+    rect_t srcRect = RECT_INIT_GFX(src);
+    gfx_scale(&scaled->gfx, src, &destRect, &srcRect, filter);
+    scaled->gfx.invalidRegion = REGION_INIT();
+    return &scaled->gfx;
+}
+
+void gfx_scaled_cleanup(gfx_scaled_t* scaled)
+{
+    free(scaled->gfx.buffer);
+    *scaled = (gfx_scaled_t){0};
+}
+
+// Converts the pixels of gfx to premultiplied alpha, images that turn out to be fully opaque are marked as such so that
+// blending them becomes a copy.
+void gfx_premultiply(gfx_t* gfx)
+{
+    bool opaque = true;
+    for (uint32_t y = 0; y < gfx->height; y++)
+    {
+        pixel_t* row = &gfx->buffer[y * gfx->stride];
+        for (uint32_t x = 0; x < gfx->width; x++)
+        {
+            opaque = opaque && PIXEL_ALPHA(row[x]) == 0xFF;
+            row[x] = gfx_premultiply_pixel(row[x]);
+        }
+    }
+
+    gfx->flags = GFX_PREMULTIPLIED | (opaque ? GFX_OPAQUE : GFX_NONE);
+}
+
 void gfx_invalidate(gfx_t* gfx, const rect_t* rect)
 {
-    if (RECT_AREA(&gfx->invalidRect) == 0)
+    region_add(&gfx->invalidRegion, rect);
+}
+
+#define GFX_CMD_BAND_HEIGHT 16
+
+void gfx_cmd_list_init(gfx_cmd_list_t* list, gfx_t* gfx)
+{
+    list->gfx = gfx;
+    list->amount = 0;
+}
+
+static void gfx_cmd_rows(gfx_t* gfx, const gfx_cmd_t* cmd, int64_t top, int64_t bottom)
+{
+    const gfx_pixel_ops_t* ops = gfx_pixel_ops();
+    const rect_t* rect = &cmd->rect;
+
+    switch (cmd->type)
     {
-        gfx->invalidRect = *rect;
+    case GFX_CMD_RECT:
+    {
+        for (int64_t y = top; y < bottom; y++)
+        {
+            ops->fill(&gfx->buffer[rect->left + y * gfx->stride], cmd->fill.pixel, RECT_WIDTH(rect));
+        }
     }
-    else
+    break;
+    case GFX_CMD_EDGE:
+    {
+        for (int64_t y = top; y < bottom; y++)
+        {
+            gfx_edge_row(gfx, rect, cmd->edge.width, cmd->edge.foreground, cmd->edge.background, y);
+        }
+    }
+    break;
+    case GFX_CMD_TEXT:
+    {
+        gfx_psf_rows(gfx, cmd->text.psf, rect, cmd->text.scale, cmd->text.str, cmd->text.amount, cmd->text.dots,
+            cmd->text.foreground, cmd->text.background, top - rect->top, bottom - rect->top);
+    }
+    break;
+    case GFX_CMD_TRANSFER:
+    case GFX_CMD_TRANSFER_BLEND:
+    {
+        const gfx_t* src = cmd->transfer.src;
+        void (*draw)(pixel_t*, const pixel_t*, uint64_t) = ops->copy;
+        if (cmd->type == GFX_CMD_TRANSFER_BLEND && !(src->flags & GFX_OPAQUE))
+        {
+            draw = src->flags & GFX_PREMULTIPLIED ? ops->blendPremultiplied : ops->blend;
+        }
+
+        for (int64_t y = top; y < bottom; y++)
+        {
+            draw(&gfx->buffer[rect->left + y * gfx->stride],
+                &src->buffer[cmd->transfer.srcPoint.x + (y - rect->top + cmd->transfer.srcPoint.y) * src->stride],
+                RECT_WIDTH(rect));
+        }
+    }
+    break;
+    default:
+    {
+    }
+    break;
+    }
+}
+
+void gfx_cmd_list_flush(gfx_cmd_list_t* list)
+{
+    gfx_t* gfx = list->gfx;
+    const gfx_cmd_t* cmds = list->cmds;
+    if (list->amount == 0)
+    {
+        return;
+    }
+
+    // Commands are picked up in order of their top row, the active ones are kept in recorded order so overlapping
+    // commands end up the same as if they were drawn one after another.
+    uint8_t sorted[GFX_CMD_LIST_MAX];
+    int64_t bottom = 0;
+    for (uint64_t i = 0; i < list->amount; i++)
+    {
+        uint64_t j = i;
+        while (j > 0 && cmds[sorted[j - 1]].rect.top > cmds[i].rect.top)
+        {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = i;
+        bottom = MAX(bottom, cmds[i].rect.bottom);
+    }
+    bottom = MIN(bottom, (int64_t)gfx->height);
+
+    uint8_t active[GFX_CMD_LIST_MAX];
+    uint64_t activeAmount = 0;
+    uint64_t next = 0;
+    int64_t bandTop = MAX(0, cmds[sorted[0]].rect.top);
+    while (bandTop < bottom)
+    {
+        uint64_t kept = 0;
+        for (uint64_t i = 0; i < activeAmount; i++)
+        {
+            if (cmds[active[i]].rect.bottom > bandTop)
+            {
+                active[kept++] = active[i];
+            }
+        }
+        activeAmount = kept;
+
+        if (activeAmount == 0)
+        {
+            if (next == list->amount)
+            {
+                break;
+            }
+            bandTop = MAX(bandTop, cmds[sorted[next]].rect.top);
+        }
+        int64_t bandBottom = MIN(bandTop + GFX_CMD_BAND_HEIGHT, bottom);
+
+        for (; next < list->amount && cmds[sorted[next]].rect.top < bandBottom; next++)
+        {
+            uint64_t j = activeAmount++;
+            while (j > 0 && active[j - 1] > sorted[next])
+            {
+                active[j] = active[j - 1];
+                j--;
+            }
+            active[j] = sorted[next];
+        }
+
+        for (uint64_t i = 0; i < activeAmount; i++)
+        {
+            const gfx_cmd_t* cmd = &cmds[active[i]];
+            gfx_cmd_rows(gfx, cmd, MAX(bandTop, cmd->rect.top), MIN(bandBottom, cmd->rect.bottom));
+        }
+
+        bandTop = bandBottom;
+    }
+
+    for (uint64_t i = 0; i < list->amount; i++)
+    {
+        gfx_invalidate(gfx, &cmds[i].rect);
+    }
+    list->amount = 0;
+}
+
+static void gfx_cmd_push(gfx_cmd_list_t* list, const gfx_cmd_t* cmd)
+{
+    if (RECT_WIDTH(&cmd->rect) <= 0 || RECT_HEIGHT(&cmd->rect) <= 0)
+    {
+        return;
+    }
+
+    if (cmd->type == GFX_CMD_RECT)
+    {
+        // A fill overwrites everything below it, so earlier commands that it covers completely are dropped.
+        uint64_t kept = 0;
+        for (uint64_t i = 0; i < list->amount; i++)
+        {
+            if (!RECT_CONTAINS(&cmd->rect, &list->cmds[i].rect))
+            {
+                list->cmds[kept++] = list->cmds[i];
+            }
+        }
+        list->amount = kept;
+
+        // Fills of the same pixel that continue the previous one are merged into it.
+        gfx_cmd_t* prev = list->amount != 0 ? &list->cmds[list->amount - 1] : NULL;
+        if (prev != NULL && prev->type == GFX_CMD_RECT && prev->fill.pixel == cmd->fill.pixel)
+        {
+            const rect_t* rect = &cmd->rect;
+            if (prev->rect.top == rect->top && prev->rect.bottom == rect->bottom &&
+                (prev->rect.right == rect->left || prev->rect.left == rect->right))
+            {
+                prev->rect.left = MIN(prev->rect.left, rect->left);
+                prev->rect.right = MAX(prev->rect.right, rect->right);
+                return;
+            }
+            if (prev->rect.left == rect->left && prev->rect.right == rect->right &&
+                (prev->rect.bottom == rect->top || prev->rect.top == rect->bottom))
+            {
+                prev->rect.top = MIN(prev->rect.top, rect->top);
+                prev->rect.bottom = MAX(prev->rect.bottom, rect->bottom);
+                return;
+            }
+        }
+    }
+
+    if (list->amount == GFX_CMD_LIST_MAX)
+    {
+        gfx_cmd_list_flush(list);
+    }
+    list->cmds[list->amount++] = *cmd;
+}
+
+void gfx_cmd_rect(gfx_cmd_list_t* list, const rect_t* rect, pixel_t pixel)
+{
+    gfx_cmd_t cmd = {.type = GFX_CMD_RECT, .rect = *rect, .fill.pixel = pixel};
+    gfx_cmd_push(list, &cmd);
+}
+
+void gfx_cmd_edge(gfx_cmd_list_t* list, const rect_t* rect, uint64_t width, pixel_t foreground, pixel_t background)
+{
+    gfx_cmd_t cmd = {
+        .type = GFX_CMD_EDGE,
+        .rect = *rect,
+        .edge.width = width,
+        .edge.foreground = foreground,
+        .edge.background = background,
+    };
+    gfx_cmd_push(list, &cmd);
+}
+
+void gfx_cmd_ridge(gfx_cmd_list_t* list, const rect_t* rect, uint64_t width, pixel_t foreground, pixel_t background)
+{
+    gfx_cmd_edge(list, rect, width / 2, background, foreground);
+
+    rect_t innerRect = *rect;
+    RECT_SHRINK(&innerRect, width / 2);
+    gfx_cmd_edge(list, &innerRect, width / 2, foreground, background);
+}
+
+void gfx_cmd_rim(gfx_cmd_list_t* list, const rect_t* rect, uint64_t width, pixel_t pixel)
+{
+    rect_t leftRect = RECT_INIT(rect->left, rect->top + width - width / 2, rect->left + width,
+        rect->bottom - width + width / 2);
+    gfx_cmd_rect(list, &leftRect, pixel);
+
+    rect_t topRect = RECT_INIT(rect->left + width - width / 2, rect->top, rect->right - width + width / 2,
+        rect->top + width);
+    gfx_cmd_rect(list, &topRect, pixel);
+
+    rect_t rightRect = RECT_INIT(rect->right - width, rect->top + width - width / 2, rect->right,
+        rect->bottom - width + width / 2);
+    gfx_cmd_rect(list, &rightRect, pixel);
+
+    rect_t bottomRect = RECT_INIT(rect->left + width - width / 2, rect->bottom - width, rect->right - width + width / 2,
+        rect->bottom);
+    gfx_cmd_rect(list, &bottomRect, pixel);
+}
+
+void gfx_cmd_psf(gfx_cmd_list_t* list, gfx_psf_t* psf, const rect_t* rect, gfx_align_t xAlign, gfx_align_t yAlign,
+    uint64_t height, const char* str, pixel_t foreground, pixel_t background)
+{
+    gfx_cmd_t cmd = {
+        .type = GFX_CMD_TEXT,
+        .text.psf = psf,
+        .text.str = str,
+        .text.foreground = foreground,
+        .text.background = background,
+    };
+    if (!gfx_psf_layout(psf, rect, xAlign, yAlign, height, str, &cmd.rect, &cmd.text.scale, &cmd.text.amount,
+            &cmd.text.dots))
+    {
+        return;
+    }
+    gfx_cmd_push(list, &cmd);
+}
+
+void gfx_cmd_transfer(gfx_cmd_list_t* list, const gfx_t* src, const rect_t* destRect, const point_t* srcPoint)
+{
+    gfx_cmd_t cmd = {.type = GFX_CMD_TRANSFER, .rect = *destRect, .transfer.src = src, .transfer.srcPoint = *srcPoint};
+    gfx_cmd_push(list, &cmd);
+}
+
+void gfx_cmd_transfer_blend(gfx_cmd_list_t* list, const gfx_t* src, const rect_t* destRect, const point_t* srcPoint)
+{
+    gfx_cmd_t cmd = {
+        .type = GFX_CMD_TRANSFER_BLEND,
+        .rect = *destRect,
+        .transfer.src = src,
+        .transfer.srcPoint = *srcPoint,
+    };
+    gfx_cmd_push(list, &cmd);
+}
+
+static uint64_t region_waste(const rect_t* rect, const rect_t* other)
+{
+    rect_t bounds = RECT_UNION(rect, other);
+    return RECT_AREA(&bounds) - RECT_AREA(rect) - RECT_AREA(other);
+}
+
+static void region_remove(region_t* region, uint8_t index)
+{
+    region->rects[index] = region->rects[--region->count];
+}
+
+void region_add(region_t* region, const rect_t* rect)
+{
+    if (RECT_WIDTH(rect) <= 0 || RECT_HEIGHT(rect) <= 0)
+    {
+        return;
+    }
+
+    // Overlapping rects are always merged to keep the set disjoint, touching rects are merged when their bounds cover
+    // no extra pixels.
+    rect_t newRect = *rect;
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (uint8_t i = 0; i < region->count; i++)
+        {
+            rect_t* other = &region->rects[i];
+            if (RECT_CONTAINS(other, &newRect))
+            {
+                return;
+            }
+
+            if (RECT_OVERLAP(other, &newRect) || region_waste(other, &newRect) == 0)
+            {
+                newRect = RECT_UNION(other, &newRect);
+                region_remove(region, i);
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    if (region->count < REGION_MAX_RECT)
+    {
+        region->rects[region->count++] = newRect;
+        return;
+    }
+
+    // Full, fold the rect into the one that wastes the fewest pixels, the result can overlap others so add it again.
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < region->count; i++)
+    {
+        if (region_waste(&region->rects[i], &newRect) < region_waste(&region->rects[best], &newRect))
+        {
+            best = i;
+        }
+    }
+
+    newRect = RECT_UNION(&region->rects[best], &newRect);
+    region_remove(region, best);
+    region_add(region, &newRect);
+}
+
+void region_bounds(const region_t* region, rect_t* rect)
+{
+    *rect = (rect_t){0};
+    for (uint8_t i = 0; i < region->count; i++)
     {
-        gfx->invalidRect.left = MIN(gfx->invalidRect.left, rect->left);
-        gfx->invalidRect.top = MIN(gfx->invalidRect.top, rect->top);
-        gfx->invalidRect.right = MAX(gfx->invalidRect.right, rect->right);
-        gfx->invalidRect.bottom = MAX(gfx->invalidRect.bottom, rect->bottom);
+        *rect = i == 0 ? region->rects[0] : RECT_UNION(rect, &region->rects[i]);
     }
 }
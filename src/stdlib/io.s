@@ -64,4 +64,39 @@ listdir:
     SYSTEM_CALL SYS_LISTDIR
     ret
 
+global readv
+readv:
+    SYSTEM_CALL SYS_READV
+    ret
+
+global writev
+writev:
+    SYSTEM_CALL SYS_WRITEV
+    ret
+
+global pread
+pread:
+    SYSTEM_CALL SYS_PREAD
+    ret
+
+global pwrite
+pwrite:
+    SYSTEM_CALL SYS_PWRITE
+    ret
+
+global create
+create:
+    SYSTEM_CALL SYS_CREATE
+    ret
+
+global unlink
+unlink:
+    SYSTEM_CALL SYS_UNLINK
+    ret
+
+global truncate
+truncate:
+    SYSTEM_CALL SYS_TRUNCATE
+    ret
+
 %endif
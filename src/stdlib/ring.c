@@ -0,0 +1,69 @@
+#ifndef __EMBED__
+
+#include <stdatomic.h>
+#include <sys/io.h>
+#include <sys/proc.h>
+#include <sys/ring.h>
+
+fd_t ring_setup(ring_t** out)
+{
+    fd_t fd = open("sys:/ring");
+    if (fd == ERR)
+    {
+        return ERR;
+    }
+
+    *out = mmap(fd, NULL, sizeof(ring_t), PROT_READ | PROT_WRITE);
+    if (*out == NULL)
+    {
+        close(fd);
+        return ERR;
+    }
+
+    return fd;
+}
+
+ring_sqe_t* ring_sqe_get(ring_t* ring)
+{
+    uint32_t tail = atomic_load(&ring->sqTail);
+    if (tail - atomic_load(&ring->sqHead) >= RING_SQ_MAX)
+    {
+        return NULL;
+    }
+
+    return &ring->sq[RING_SQ_INDEX(tail)];
+}
+
+void ring_submit(ring_t* ring)
+{
+    atomic_fetch_add(&ring->sqTail, 1);
+}
+
+uint64_t ring_enter(fd_t fd, uint64_t amount)
+{
+    ioctl_ring_enter_t enter = {.amount = amount};
+    if (ioctl(fd, IOCTL_RING_ENTER, &enter, sizeof(ioctl_ring_enter_t)) == ERR)
+    {
+        return ERR;
+    }
+
+    return enter.outCompleted;
+}
+
+ring_cqe_t* ring_cqe_peek(ring_t* ring)
+{
+    uint32_t head = atomic_load(&ring->cqHead);
+    if (head == atomic_load(&ring->cqTail))
+    {
+        return NULL;
+    }
+
+    return &ring->cq[RING_CQ_INDEX(head)];
+}
+
+void ring_cqe_seen(ring_t* ring)
+{
+    atomic_fetch_add(&ring->cqHead, 1);
+}
+
+#endif
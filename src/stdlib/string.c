@@ -25,6 +25,7 @@ static char* errorStrings[] = {
     "is a directory",
     "no such resource",
     "busy",
+    "no space left",
 };
 
 void* memcpy(void* _RESTRICT dest, const void* _RESTRICT src, size_t count)
@@ -263,7 +264,7 @@ size_t strlen(const char* str)
 
 char* strerror(int error)
 {
-    if (error > EBUSY || error < 0)
+    if (error > ENOSPC || error < 0)
     {
         return "Unknown error";
     }
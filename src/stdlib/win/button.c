@@ -21,30 +21,33 @@ static void button_draw(widget_t* widget, win_t* window, bool redraw)
 
     gfx_t gfx;
     win_draw_begin(window, &gfx);
+    gfx_cmd_list_t list;
+    gfx_cmd_list_init(&list, &gfx);
 
     if (redraw)
     {
-        gfx_rim(&gfx, &rect, winTheme.rimWidth, winTheme.dark);
+        gfx_cmd_rim(&list, &rect, winTheme.rimWidth, winTheme.dark);
     }
     RECT_SHRINK(&rect, winTheme.rimWidth);
 
     if (button->pressed)
     {
-        gfx_edge(&gfx, &rect, winTheme.edgeWidth, winTheme.shadow, winTheme.highlight);
+        gfx_cmd_edge(&list, &rect, winTheme.edgeWidth, winTheme.shadow, winTheme.highlight);
     }
     else
     {
-        gfx_edge(&gfx, &rect, winTheme.edgeWidth, winTheme.highlight, winTheme.shadow);
+        gfx_cmd_edge(&list, &rect, winTheme.edgeWidth, winTheme.highlight, winTheme.shadow);
     }
     RECT_SHRINK(&rect, winTheme.edgeWidth);
 
     if (redraw)
     {
-        gfx_rect(&gfx, &rect, winTheme.background);
-        gfx_psf(&gfx, win_font(window), &rect, button->props.xAlign, button->props.yAlign, button->props.height,
+        gfx_cmd_rect(&list, &rect, winTheme.background);
+        gfx_cmd_psf(&list, win_font(window), &rect, button->props.xAlign, button->props.yAlign, button->props.height,
             win_widget_name(widget), button->props.foreground, button->props.background);
     }
 
+    gfx_cmd_list_flush(&list);
     win_draw_end(window, &gfx);
 }
 
@@ -14,8 +14,19 @@ typedef struct widget widget_t;
 #include <sys/list.h>
 #include <sys/math.h>
 #include <sys/mouse.h>
+#include <sys/proc.h>
 
 #define WIN_WIDGET_MAX_MSG 8
+#define WIN_RECEIVE_BATCH_MAX 16
+#define WIN_WIDGET_CELL_SIZE 64
+
+// A cell of the uniform grid over the client area used to find the widgets below a point.
+typedef struct
+{
+    widget_t** widgets;
+    uint32_t amount;
+    uint32_t capacity;
+} win_cell_t;
 
 typedef struct win
 {
@@ -28,6 +39,13 @@ typedef struct win
     win_flags_t flags;
     win_proc_t procedure;
     list_t widgets;
+    win_cell_t* cells;
+    uint32_t cellColumns;
+    uint32_t cellRows;
+    bool cellsValid;
+    widget_t* capture;
+    uint64_t mouseStamp;
+    region_t invalidRegion;
     bool selected;
     bool moving;
     bool closeButtonPressed;
@@ -46,9 +64,24 @@ typedef struct widget
     msg_t messages[WIN_WIDGET_MAX_MSG];
     uint8_t writeIndex;
     uint8_t readIndex;
+    bool dirty;
+    uint64_t mouseStamp;
     char* name;
 } widget_t;
 
+typedef struct
+{
+    win_t* window;
+    win_timer_id_t id;
+    nsec_t deadline;
+    nsec_t interval; // Zero for one shot timers.
+} win_timer_t;
+
+// Min-heap of all timers in the process ordered by deadline.
+static win_timer_t* timers = NULL;
+static uint64_t timerAmount = 0;
+static uint64_t timerCapacity = 0;
+
 // TODO: this should be stored in some sort of config file, lua? make something custom?
 #define WIN_DEFAULT_FONT "home:/fonts/zap-vga16.psf"
 win_theme_t winTheme = {
@@ -67,7 +100,210 @@ win_theme_t winTheme = {
 };
 
 static uint64_t win_widget_dispatch(widget_t* widget, const msg_t* msg);
-static void win_close_button_draw(win_t* window, gfx_t* gfx);
+static void win_timer_remove(uint64_t index);
+static void win_close_button_draw(win_t* window, gfx_cmd_list_t* list);
+
+// The buffer is the compositors own surface mapped into our address space, drawing into it needs no copy.
+static pixel_t* win_surface_map(win_t* window, uint32_t width, uint32_t height)
+{
+    return mmap(window->fd, NULL, width * height * sizeof(pixel_t), PROT_READ | PROT_WRITE);
+}
+
+// Reports each damaged rect separately so the compositor only recomposes what changed.
+static uint64_t win_flush(win_t* window, const region_t* region, const point_t* offset)
+{
+    for (uint8_t i = 0; i < region->count; i++)
+    {
+        rect_t rect = region->rects[i];
+        rect.left += offset->x;
+        rect.top += offset->y;
+        rect.right += offset->x;
+        rect.bottom += offset->y;
+
+        if (flush(window->fd, NULL, 0, &rect) == ERR)
+        {
+            return ERR;
+        }
+    }
+
+    return 0;
+}
+
+// Damage is collected while dispatching a message and flushed once at the end of win_dispatch().
+static void win_invalidate(win_t* window, const region_t* region, const point_t* offset)
+{
+    for (uint8_t i = 0; i < region->count; i++)
+    {
+        rect_t rect = region->rects[i];
+        rect.left += offset->x;
+        rect.top += offset->y;
+        rect.right += offset->x;
+        rect.bottom += offset->y;
+        region_add(&window->invalidRegion, &rect);
+    }
+}
+
+static void win_cells_free(win_t* window)
+{
+    for (uint64_t i = 0; i < (uint64_t)window->cellColumns * window->cellRows; i++)
+    {
+        free(window->cells[i].widgets);
+    }
+    free(window->cells);
+    window->cells = NULL;
+    window->cellColumns = 0;
+    window->cellRows = 0;
+    window->cellsValid = false;
+}
+
+static uint64_t win_cell_push(win_cell_t* cell, widget_t* widget)
+{
+    if (cell->amount == cell->capacity)
+    {
+        uint32_t capacity = cell->capacity == 0 ? 4 : cell->capacity * 2;
+        widget_t** widgets = realloc(cell->widgets, sizeof(widget_t*) * capacity);
+        if (widgets == NULL)
+        {
+            return ERR;
+        }
+        cell->widgets = widgets;
+        cell->capacity = capacity;
+    }
+
+    cell->widgets[cell->amount++] = widget;
+    return 0;
+}
+
+// Rebuilt lazily after widgets are added or removed or the window is resized, widget rects never change otherwise.
+static uint64_t win_cells_build(win_t* window)
+{
+    if (window->cellsValid)
+    {
+        return 0;
+    }
+    win_cells_free(window);
+
+    uint32_t columns = MAX((RECT_WIDTH(&window->clientRect) + WIN_WIDGET_CELL_SIZE - 1) / WIN_WIDGET_CELL_SIZE, 1);
+    uint32_t rows = MAX((RECT_HEIGHT(&window->clientRect) + WIN_WIDGET_CELL_SIZE - 1) / WIN_WIDGET_CELL_SIZE, 1);
+    window->cells = calloc((uint64_t)columns * rows, sizeof(win_cell_t));
+    if (window->cells == NULL)
+    {
+        return ERR;
+    }
+    window->cellColumns = columns;
+    window->cellRows = rows;
+
+    widget_t* widget;
+    LIST_FOR_EACH(widget, &window->widgets)
+    {
+        if (RECT_WIDTH(&widget->rect) <= 0 || RECT_HEIGHT(&widget->rect) <= 0)
+        {
+            continue;
+        }
+
+        int64_t left = CLAMP(widget->rect.left / WIN_WIDGET_CELL_SIZE, 0, columns - 1);
+        int64_t top = CLAMP(widget->rect.top / WIN_WIDGET_CELL_SIZE, 0, rows - 1);
+        int64_t right = CLAMP((widget->rect.right - 1) / WIN_WIDGET_CELL_SIZE, 0, columns - 1);
+        int64_t bottom = CLAMP((widget->rect.bottom - 1) / WIN_WIDGET_CELL_SIZE, 0, rows - 1);
+
+        for (int64_t y = top; y <= bottom; y++)
+        {
+            for (int64_t x = left; x <= right; x++)
+            {
+                if (win_cell_push(&window->cells[x + y * columns], widget) == ERR)
+                {
+                    win_cells_free(window);
+                    return ERR;
+                }
+            }
+        }
+    }
+
+    window->cellsValid = true;
+    return 0;
+}
+
+// Sends the message to every widget containing point that has not received the current mouse message yet.
+static void win_widget_send_at(win_t* window, const point_t* point, msg_type_t type, const void* data, uint64_t size)
+{
+    if (point->x < 0 || point->y < 0 || win_cells_build(window) == ERR)
+    {
+        return;
+    }
+
+    uint64_t column = point->x / WIN_WIDGET_CELL_SIZE;
+    uint64_t row = point->y / WIN_WIDGET_CELL_SIZE;
+    if (column >= window->cellColumns || row >= window->cellRows)
+    {
+        return;
+    }
+
+    win_cell_t* cell = &window->cells[column + row * window->cellColumns];
+    for (uint32_t i = 0; i < cell->amount; i++)
+    {
+        widget_t* widget = cell->widgets[i];
+        if (widget->mouseStamp != window->mouseStamp && RECT_CONTAINS_POINT(&widget->rect, point))
+        {
+            widget->mouseStamp = window->mouseStamp;
+            win_widget_send(widget, type, data, size);
+        }
+    }
+}
+
+static widget_t* win_widget_at(win_t* window, const point_t* point)
+{
+    if (point->x < 0 || point->y < 0 || win_cells_build(window) == ERR)
+    {
+        return NULL;
+    }
+
+    uint64_t column = point->x / WIN_WIDGET_CELL_SIZE;
+    uint64_t row = point->y / WIN_WIDGET_CELL_SIZE;
+    if (column >= window->cellColumns || row >= window->cellRows)
+    {
+        return NULL;
+    }
+
+    // Cells keep the id order of the widget list, later widgets are considered to be on top.
+    widget_t* found = NULL;
+    win_cell_t* cell = &window->cells[column + row * window->cellColumns];
+    for (uint32_t i = 0; i < cell->amount; i++)
+    {
+        if (RECT_CONTAINS_POINT(&cell->widgets[i]->rect, point))
+        {
+            found = cell->widgets[i];
+        }
+    }
+    return found;
+}
+
+// Mouse messages only go to widgets below the pointer, widgets below its previous position so they notice it leaving,
+// and the widget that captured the mouse by being pressed until all buttons are released.
+static void win_widget_send_mouse(win_t* window, const wmsg_mouse_t* data)
+{
+    point_t pos = data->pos;
+    win_screen_to_client(window, &pos);
+    point_t prevPos = {.x = pos.x - data->delta.x, .y = pos.y - data->delta.y};
+
+    if (data->pressed != MOUSE_NONE && window->capture == NULL)
+    {
+        window->capture = win_widget_at(window, &pos);
+    }
+
+    window->mouseStamp++;
+    win_widget_send_at(window, &pos, WMSG_MOUSE, data, sizeof(wmsg_mouse_t));
+    win_widget_send_at(window, &prevPos, WMSG_MOUSE, data, sizeof(wmsg_mouse_t));
+    if (window->capture != NULL && window->capture->mouseStamp != window->mouseStamp)
+    {
+        window->capture->mouseStamp = window->mouseStamp;
+        win_widget_send(window->capture, WMSG_MOUSE, data, sizeof(wmsg_mouse_t));
+    }
+
+    if (data->held == MOUSE_NONE)
+    {
+        window->capture = NULL;
+    }
+}
 
 static uint64_t win_set_rect(win_t* window, const rect_t* rect)
 {
@@ -77,25 +313,28 @@ static uint64_t win_set_rect(win_t* window, const rect_t* rect)
 
     window->clientRect = RECT_INIT_DIM(0, 0, window->width, window->height);
     win_shrink_to_client(&window->clientRect, window->flags);
+    window->cellsValid = false;
 
     return 0;
 }
 
 static inline void win_window_surface(win_t* window, gfx_t* gfx)
 {
-    gfx->invalidRect = (rect_t){0};
+    gfx->invalidRegion = REGION_INIT();
     gfx->buffer = window->buffer;
     gfx->width = window->width;
     gfx->height = window->height;
     gfx->stride = gfx->width;
+    gfx->flags = GFX_NONE;
 }
 
 static inline void win_client_surface(win_t* window, gfx_t* gfx)
 {
-    gfx->invalidRect = (rect_t){0};
+    gfx->invalidRegion = REGION_INIT();
     gfx->width = RECT_WIDTH(&window->clientRect);
     gfx->height = RECT_HEIGHT(&window->clientRect);
     gfx->stride = window->width;
+    gfx->flags = GFX_NONE;
     gfx->buffer = &window->buffer[window->clientRect.left + window->clientRect.top * gfx->stride];
 }
 
@@ -109,20 +348,20 @@ static void win_topbar_rect(win_t* window, rect_t* rect)
     };
 }
 
-static void win_topbar_draw(win_t* window, gfx_t* gfx)
+static void win_topbar_draw(win_t* window, gfx_cmd_list_t* list)
 {
     rect_t rect;
     win_topbar_rect(window, &rect);
 
-    gfx_edge(gfx, &rect, winTheme.edgeWidth, winTheme.dark, winTheme.highlight);
+    gfx_cmd_edge(list, &rect, winTheme.edgeWidth, winTheme.dark, winTheme.highlight);
     RECT_SHRINK(&rect, winTheme.edgeWidth);
-    gfx_rect(gfx, &rect, window->selected ? winTheme.selected : winTheme.unSelected);
+    gfx_cmd_rect(list, &rect, window->selected ? winTheme.selected : winTheme.unSelected);
 
-    win_close_button_draw(window, gfx);
+    win_close_button_draw(window, list);
 
     rect.left += winTheme.topbarPadding * 3;
     rect.right -= winTheme.topbarHeight;
-    gfx_psf(gfx, &window->psf, &rect, GFX_MIN, GFX_CENTER, 16, window->name, winTheme.background, 0);
+    gfx_cmd_psf(list, &window->psf, &rect, GFX_MIN, GFX_CENTER, 16, window->name, winTheme.background, 0);
 }
 
 static void win_close_button_rect(win_t* window, rect_t* rect)
@@ -132,38 +371,38 @@ static void win_close_button_rect(win_t* window, rect_t* rect)
     rect->left = rect->right - (rect->bottom - rect->top);
 }
 
-static void win_close_button_draw(win_t* window, gfx_t* gfx)
+static void win_close_button_draw(win_t* window, gfx_cmd_list_t* list)
 {
     rect_t rect;
     win_close_button_rect(window, &rect);
 
-    gfx_rim(gfx, &rect, winTheme.rimWidth, winTheme.dark);
+    gfx_cmd_rim(list, &rect, winTheme.rimWidth, winTheme.dark);
     RECT_SHRINK(&rect, winTheme.rimWidth);
 
     if (window->closeButtonPressed)
     {
-        gfx_edge(gfx, &rect, winTheme.edgeWidth, winTheme.shadow, winTheme.highlight);
+        gfx_cmd_edge(list, &rect, winTheme.edgeWidth, winTheme.shadow, winTheme.highlight);
     }
     else
     {
-        gfx_edge(gfx, &rect, winTheme.edgeWidth, winTheme.highlight, winTheme.shadow);
+        gfx_cmd_edge(list, &rect, winTheme.edgeWidth, winTheme.highlight, winTheme.shadow);
     }
     RECT_SHRINK(&rect, winTheme.edgeWidth);
-    gfx_rect(gfx, &rect, winTheme.background);
+    gfx_cmd_rect(list, &rect, winTheme.background);
 
     RECT_EXPAND(&rect, 32);
-    gfx_psf(gfx, &window->psf, &rect, GFX_CENTER, GFX_CENTER, 32, "x", winTheme.shadow, 0);
+    gfx_cmd_psf(list, &window->psf, &rect, GFX_CENTER, GFX_CENTER, 32, "x", winTheme.shadow, 0);
 }
 
-static void win_background_draw(win_t* window, gfx_t* gfx)
+static void win_background_draw(win_t* window, gfx_cmd_list_t* list)
 {
-    rect_t rect = RECT_INIT_GFX(gfx);
+    rect_t rect = RECT_INIT_GFX(list->gfx);
 
-    gfx_rect(gfx, &rect, winTheme.background);
-    gfx_edge(gfx, &rect, winTheme.edgeWidth, winTheme.bright, winTheme.dark);
+    gfx_cmd_rect(list, &rect, winTheme.background);
+    gfx_cmd_edge(list, &rect, winTheme.edgeWidth, winTheme.bright, winTheme.dark);
 }
 
-static void win_handle_drag_and_close_button(win_t* window, gfx_t* gfx, const msg_mouse_t* data)
+static void win_handle_drag_and_close_button(win_t* window, gfx_cmd_list_t* list, const msg_mouse_t* data)
 {
     rect_t topBar;
     win_topbar_rect(window, &topBar);
@@ -187,7 +426,7 @@ static void win_handle_drag_and_close_button(win_t* window, gfx_t* gfx, const ms
         if (!RECT_CONTAINS_POINT(&closeButton, &mousePos))
         {
             window->closeButtonPressed = false;
-            win_close_button_draw(window, gfx);
+            win_close_button_draw(window, list);
         }
         else if (data->released & MOUSE_LEFT)
         {
@@ -199,7 +438,7 @@ static void win_handle_drag_and_close_button(win_t* window, gfx_t* gfx, const ms
         if (RECT_CONTAINS_POINT(&closeButton, &mousePos))
         {
             window->closeButtonPressed = true;
-            win_close_button_draw(window, gfx);
+            win_close_button_draw(window, list);
         }
         else
         {
@@ -212,6 +451,8 @@ static void win_background_procedure(win_t* window, const msg_t* msg)
 {
     gfx_t gfx;
     win_window_surface(window, &gfx);
+    gfx_cmd_list_t list;
+    gfx_cmd_list_init(&list, &gfx);
 
     switch (msg->type)
     {
@@ -221,11 +462,10 @@ static void win_background_procedure(win_t* window, const msg_t* msg)
 
         if (window->flags & WIN_DECO)
         {
-            win_handle_drag_and_close_button(window, &gfx, data);
+            win_handle_drag_and_close_button(window, &list, data);
         }
 
-        wmsg_mouse_t wmsg = *data;
-        win_widget_send_all(window, WMSG_MOUSE, &wmsg, sizeof(wmsg_mouse_t));
+        win_widget_send_mouse(window, data);
     }
     break;
     case MSG_SELECT:
@@ -233,7 +473,7 @@ static void win_background_procedure(win_t* window, const msg_t* msg)
         window->selected = true;
         if (window->flags & WIN_DECO)
         {
-            win_topbar_draw(window, &gfx);
+            win_topbar_draw(window, &list);
         }
     }
     break;
@@ -242,7 +482,7 @@ static void win_background_procedure(win_t* window, const msg_t* msg)
         window->selected = false;
         if (window->flags & WIN_DECO)
         {
-            win_topbar_draw(window, &gfx);
+            win_topbar_draw(window, &list);
         }
     }
     break;
@@ -250,8 +490,8 @@ static void win_background_procedure(win_t* window, const msg_t* msg)
     {
         if (window->flags & WIN_DECO)
         {
-            win_background_draw(window, &gfx);
-            win_topbar_draw(window, &gfx);
+            win_background_draw(window, &list);
+            win_topbar_draw(window, &list);
         }
 
         win_widget_send_all(window, WMSG_REDRAW, NULL, 0);
@@ -259,11 +499,9 @@ static void win_background_procedure(win_t* window, const msg_t* msg)
     break;
     }
 
-    if (RECT_AREA(&gfx.invalidRect) != 0 &&
-        flush(window->fd, window->buffer, window->width * window->height * sizeof(pixel_t), &gfx.invalidRect) == ERR)
-    {
-        win_send(window, LMSG_QUIT, NULL, 0);
-    }
+    gfx_cmd_list_flush(&list);
+    point_t offset = {0};
+    win_invalidate(window, &gfx.invalidRegion, &offset);
 }
 
 win_t* win_new(const char* name, const rect_t* rect, dwm_type_t type, win_flags_t flags, win_proc_t procedure)
@@ -295,21 +533,28 @@ win_t* win_new(const char* name, const rect_t* rect, dwm_type_t type, win_flags_
     strcpy(create.name, name);
     if (ioctl(window->fd, IOCTL_DWM_CREATE, &create, sizeof(ioctl_dwm_create_t)) == ERR)
     {
-        free(window);
         close(window->fd);
+        free(window);
         return NULL;
     }
 
-    window->buffer = calloc(create.width * create.height, sizeof(pixel_t));
+    window->buffer = win_surface_map(window, create.width, create.height);
     if (window->buffer == NULL)
     {
-        free(window);
         close(window->fd);
+        free(window);
         return NULL;
     }
 
     window->flags = flags;
     list_init(&window->widgets);
+    window->cells = NULL;
+    window->cellColumns = 0;
+    window->cellRows = 0;
+    window->cellsValid = false;
+    window->capture = NULL;
+    window->mouseStamp = 0;
+    window->invalidRegion = REGION_INIT();
     window->selected = false;
     window->moving = false;
     window->closeButtonPressed = false;
@@ -318,9 +563,9 @@ win_t* win_new(const char* name, const rect_t* rect, dwm_type_t type, win_flags_
     win_set_rect(window, rect);
     if (gfx_psf_load(&window->psf, WIN_DEFAULT_FONT) == ERR)
     {
-        free(window);
-        free(window->buffer);
+        munmap(window->buffer, create.width * create.height * sizeof(pixel_t));
         close(window->fd);
+        free(window);
         return NULL;
     }
 
@@ -342,18 +587,192 @@ uint64_t win_free(win_t* window)
     msg_t msg = {.type = LMSG_FREE, .time = uptime()};
     win_dispatch(window, &msg);
 
+    for (uint64_t i = 0; i < timerAmount;)
+    {
+        if (timers[i].window == window)
+        {
+            win_timer_remove(i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
     widget_t* temp;
     widget_t* widget;
     LIST_FOR_EACH_SAFE(widget, temp, &window->widgets)
     {
         win_widget_free(widget);
     }
+    win_cells_free(window);
 
-    free(window->buffer);
     free(window);
     return 0;
 }
 
+static void win_timer_swap(uint64_t a, uint64_t b)
+{
+    win_timer_t temp = timers[a];
+    timers[a] = timers[b];
+    timers[b] = temp;
+}
+
+static void win_timer_sift_up(uint64_t index)
+{
+    while (index > 0)
+    {
+        uint64_t parent = (index - 1) / 2;
+        if (timers[parent].deadline <= timers[index].deadline)
+        {
+            break;
+        }
+        win_timer_swap(parent, index);
+        index = parent;
+    }
+}
+
+static void win_timer_sift_down(uint64_t index)
+{
+    while (1)
+    {
+        uint64_t smallest = index;
+        uint64_t left = index * 2 + 1;
+        uint64_t right = index * 2 + 2;
+
+        if (left < timerAmount && timers[left].deadline < timers[smallest].deadline)
+        {
+            smallest = left;
+        }
+        if (right < timerAmount && timers[right].deadline < timers[smallest].deadline)
+        {
+            smallest = right;
+        }
+        if (smallest == index)
+        {
+            break;
+        }
+
+        win_timer_swap(smallest, index);
+        index = smallest;
+    }
+}
+
+static void win_timer_remove(uint64_t index)
+{
+    timers[index] = timers[--timerAmount];
+    if (index < timerAmount)
+    {
+        win_timer_sift_up(index);
+        win_timer_sift_down(index);
+    }
+}
+
+static uint64_t win_timer_find(win_t* window, win_timer_id_t id)
+{
+    for (uint64_t i = 0; i < timerAmount; i++)
+    {
+        if (timers[i].window == window && timers[i].id == id)
+        {
+            return i;
+        }
+    }
+
+    return ERR;
+}
+
+// Saturates instead of wrapping so that NEVER, or any timeout too large to represent, never expires.
+static nsec_t win_timer_deadline(nsec_t time, nsec_t timeout)
+{
+    return timeout == NEVER || timeout > NEVER - time ? NEVER : time + timeout;
+}
+
+// Sends LMSG_TIMER for every expired timer. Repeating timers are rearmed relative to their deadline so they do not drift,
+// periods that were missed entirely are skipped.
+static void win_timer_fire(void)
+{
+    nsec_t time = uptime();
+    while (timerAmount != 0 && timers[0].deadline <= time)
+    {
+        win_timer_t timer = timers[0];
+        if (timer.interval != 0)
+        {
+            nsec_t next = win_timer_deadline(timer.deadline, timer.interval);
+            timers[0].deadline = next > time ? next : win_timer_deadline(time, timer.interval);
+            win_timer_sift_down(0);
+        }
+        else
+        {
+            win_timer_remove(0);
+        }
+
+        lmsg_timer_t data = {.id = timer.id};
+        win_send(timer.window, LMSG_TIMER, &data, sizeof(lmsg_timer_t));
+    }
+}
+
+// Shortens timeout so that waiting ends when the next timer expires.
+static nsec_t win_timer_timeout(nsec_t timeout)
+{
+    if (timerAmount == 0 || timers[0].deadline == NEVER)
+    {
+        return timeout;
+    }
+
+    nsec_t time = uptime();
+    nsec_t remaining = timers[0].deadline > time ? timers[0].deadline - time : 0;
+    return MIN(timeout, remaining);
+}
+
+uint64_t win_timer_set(win_t* window, win_timer_id_t id, nsec_t timeout, win_timer_flags_t flags)
+{
+    if ((flags & WIN_TIMER_REPEAT) && timeout == NEVER)
+    {
+        errno = EINVAL;
+        return ERR;
+    }
+
+    uint64_t index = win_timer_find(window, id);
+    if (index != ERR)
+    {
+        win_timer_remove(index);
+    }
+
+    if (timerAmount == timerCapacity)
+    {
+        uint64_t capacity = timerCapacity == 0 ? 8 : timerCapacity * 2;
+        win_timer_t* newTimers = realloc(timers, sizeof(win_timer_t) * capacity);
+        if (newTimers == NULL)
+        {
+            return ERR;
+        }
+        timers = newTimers;
+        timerCapacity = capacity;
+    }
+
+    timers[timerAmount] = (win_timer_t){
+        .window = window,
+        .id = id,
+        .deadline = win_timer_deadline(uptime(), timeout),
+        .interval = flags & WIN_TIMER_REPEAT ? MAX(timeout, 1) : 0,
+    };
+    win_timer_sift_up(timerAmount++);
+    return 0;
+}
+
+uint64_t win_timer_cancel(win_t* window, win_timer_id_t id)
+{
+    uint64_t index = win_timer_find(window, id);
+    if (index == ERR)
+    {
+        errno = EINVAL;
+        return ERR;
+    }
+
+    win_timer_remove(index);
+    return 0;
+}
+
 uint64_t win_poll(win_t** windows, uint64_t amount, nsec_t timeout)
 {
     pollfd_t array[amount];
@@ -361,7 +780,20 @@ uint64_t win_poll(win_t** windows, uint64_t amount, nsec_t timeout)
     {
         array[i] = (pollfd_t){.fd = windows[i]->fd, .requested = POLL_READ};
     }
-    return poll(array, amount, timeout);
+
+    // Expired timers are delivered as messages, which in turn make the windows readable.
+    win_timer_fire();
+    uint64_t result = poll(array, amount, win_timer_timeout(timeout));
+    if (result == 0 && timerAmount != 0 && timers[0].deadline <= uptime())
+    {
+        win_timer_fire();
+        for (uint64_t i = 0; i < amount; i++)
+        {
+            array[i].occurred = 0;
+        }
+        result = poll(array, amount, 0);
+    }
+    return result;
 }
 
 uint64_t win_send(win_t* window, msg_type_t type, const void* data, uint64_t size)
@@ -372,7 +804,7 @@ uint64_t win_send(win_t* window, msg_type_t type, const void* data, uint64_t siz
         return ERR;
     }
 
-    ioctl_window_send_t send = {.msg.type = type};
+    ioctl_window_send_t send = {.msg.type = type, .size = size};
     memcpy(send.msg.data, data, size);
 
     if (ioctl(window->fd, IOCTL_WINDOW_SEND, &send, sizeof(ioctl_window_send_t)) == ERR)
@@ -385,16 +817,60 @@ uint64_t win_send(win_t* window, msg_type_t type, const void* data, uint64_t siz
 
 uint64_t win_receive(win_t* window, msg_t* msg, nsec_t timeout)
 {
-    ioctl_window_receive_t receive = {.timeout = timeout};
+    win_timer_fire();
+
+    // Waiting is cut short by the next timer, which may belong to another window in which case nothing is received.
+    ioctl_window_receive_t receive = {.timeout = win_timer_timeout(timeout)};
     if (ioctl(window->fd, IOCTL_WINDOW_RECEIVE, &receive, sizeof(ioctl_window_receive_t)) == ERR)
     {
         return ERR;
     }
 
+    if (receive.outMsg.type == MSG_NONE && timerAmount != 0 && timers[0].deadline <= uptime())
+    {
+        win_timer_fire();
+        receive.timeout = 0;
+        if (ioctl(window->fd, IOCTL_WINDOW_RECEIVE, &receive, sizeof(ioctl_window_receive_t)) == ERR)
+        {
+            return ERR;
+        }
+    }
+
     *msg = receive.outMsg;
     return receive.outMsg.type != MSG_NONE;
 }
 
+uint64_t win_receive_batch(win_t* window, msg_t* msgs, uint64_t amount, nsec_t timeout)
+{
+    amount = MIN(amount, WIN_RECEIVE_BATCH_MAX);
+
+    uint8_t buffer[sizeof(ioctl_window_receive_many_t) + sizeof(msg_t) * WIN_RECEIVE_BATCH_MAX]
+        __attribute__((aligned(8)));
+    ioctl_window_receive_many_t* receive = (ioctl_window_receive_many_t*)buffer;
+    win_timer_fire();
+    receive->timeout = win_timer_timeout(timeout);
+
+    uint64_t size = sizeof(ioctl_window_receive_many_t) + sizeof(msg_t) * amount;
+    if (ioctl(window->fd, IOCTL_WINDOW_RECEIVE_MANY, receive, size) == ERR)
+    {
+        return ERR;
+    }
+
+    // Same as win_receive(), a timer that cut the wait short is delivered now instead of on the next call.
+    if (receive->outAmount == 0 && timerAmount != 0 && timers[0].deadline <= uptime())
+    {
+        win_timer_fire();
+        receive->timeout = 0;
+        if (ioctl(window->fd, IOCTL_WINDOW_RECEIVE_MANY, receive, size) == ERR)
+        {
+            return ERR;
+        }
+    }
+
+    memcpy(msgs, receive->outMsgs, sizeof(msg_t) * receive->outAmount);
+    return receive->outAmount;
+}
+
 uint64_t win_dispatch(win_t* window, const msg_t* msg)
 {
     win_background_procedure(window, msg);
@@ -408,7 +884,22 @@ uint64_t win_dispatch(win_t* window, const msg_t* msg)
             win_widget_dispatch(widget, &widget->messages[widget->readIndex]);
             widget->readIndex = (widget->readIndex + 1) % WIN_WIDGET_MAX_MSG;
         }
+
+        // Any amount of redraw requests result in a single redraw.
+        if (widget->dirty)
+        {
+            widget->dirty = false;
+            msg_t redraw = {.type = WMSG_REDRAW, .time = uptime()};
+            win_widget_dispatch(widget, &redraw);
+        }
+    }
+
+    point_t offset = {0};
+    if (win_flush(window, &window->invalidRegion, &offset) == ERR)
+    {
+        win_send(window, LMSG_QUIT, NULL, 0);
     }
+    window->invalidRegion = REGION_INIT();
 
     return result;
 }
@@ -421,18 +912,8 @@ uint64_t win_draw_begin(win_t* window, gfx_t* gfx)
 
 uint64_t win_draw_end(win_t* window, gfx_t* gfx)
 {
-    rect_t rect = (rect_t){
-        .left = window->clientRect.left + gfx->invalidRect.left,
-        .top = window->clientRect.top + gfx->invalidRect.top,
-        .right = window->clientRect.left + gfx->invalidRect.right,
-        .bottom = window->clientRect.top + gfx->invalidRect.bottom,
-    };
-
-    if (flush(window->fd, window->buffer, window->width * window->height * sizeof(pixel_t), &rect) == ERR)
-    {
-        return ERR;
-    }
-
+    point_t offset = {.x = window->clientRect.left, .y = window->clientRect.top};
+    win_invalidate(window, &gfx->invalidRegion, &offset);
     return 0;
 }
 
@@ -444,25 +925,22 @@ uint64_t win_move(win_t* window, const rect_t* rect)
     move.width = RECT_WIDTH(rect);
     move.height = RECT_HEIGHT(rect);
 
-    void* newBuffer = NULL;
-    if (window->width != move.width || window->height != move.height)
-    {
-        newBuffer = calloc(move.width * move.height, sizeof(pixel_t));
-        if (newBuffer == NULL)
-        {
-            return ERR;
-        }
-    }
+    bool resized = window->width != move.width || window->height != move.height;
 
     if (ioctl(window->fd, IOCTL_WINDOW_MOVE, &move, sizeof(ioctl_window_move_t)) == ERR)
     {
         return ERR;
     }
 
-    if (newBuffer != NULL)
+    if (resized)
     {
-        free(window->buffer);
-        window->buffer = newBuffer;
+        // Resizing may move the surface, the old mapping can no longer be trusted.
+        window->buffer = win_surface_map(window, move.width, move.height);
+        if (window->buffer == NULL)
+        {
+            win_send(window, LMSG_QUIT, NULL, 0);
+            return ERR;
+        }
 
         win_send(window, LMSG_REDRAW, NULL, 0);
     }
@@ -560,6 +1038,8 @@ widget_t* win_widget_new(win_t* window, widget_proc_t procedure, const char* nam
     widget->private = NULL;
     widget->readIndex = 0;
     widget->writeIndex = 0;
+    widget->dirty = false;
+    widget->mouseStamp = 0;
     widget->name = malloc(strlen(name) + 1);
     strcpy(widget->name, name);
 
@@ -567,6 +1047,7 @@ widget_t* win_widget_new(win_t* window, widget_proc_t procedure, const char* nam
     win_widget_dispatch(widget, &msg);
 
     win_widget_send(widget, WMSG_REDRAW, NULL, 0);
+    window->cellsValid = false;
 
     widget_t* other;
     LIST_FOR_EACH(other, &window->widgets)
@@ -587,6 +1068,12 @@ void win_widget_free(widget_t* widget)
     msg_t msg = {.type = WMSG_FREE, .time = uptime()};
     win_widget_dispatch(widget, &msg);
 
+    if (widget->window->capture == widget)
+    {
+        widget->window->capture = NULL;
+    }
+    widget->window->cellsValid = false;
+
     list_remove(widget);
     free(widget->name);
     free(widget);
@@ -594,6 +1081,12 @@ void win_widget_free(widget_t* widget)
 
 uint64_t win_widget_send(widget_t* widget, msg_type_t type, const void* data, uint64_t size)
 {
+    if (type == WMSG_REDRAW)
+    {
+        widget->dirty = true;
+        return 0;
+    }
+
     widget->messages[widget->writeIndex].type = type;
     memcpy(widget->messages[widget->writeIndex].data, data, size);
     widget->writeIndex = (widget->writeIndex + 1) % WIN_WIDGET_MAX_MSG;
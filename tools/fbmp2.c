@@ -0,0 +1,228 @@
+// Converts an uncompressed .fbmp image to the tiled, run length encoded FBMP2 format loaded by gfx_fbmp_load(), see
+// include/stdlib/sys/gfx.h for the layout. Uncompressed images can be made with https://github.com/KaiNorberg/fbmp.
+//
+// Runs on the host:
+//     cc -O2 -o fbmp2 tools/fbmp2.c
+//     ./fbmp2 [-p] [-t tileSize] input.fbmp output.fbmp
+//
+// -p stores premultiplied pixels and sets FBMP2_PREMULTIPLIED, -t sets the tile size which defaults to 32.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FBMP_MAGIC 0x706D6266
+#define FBMP2_MAGIC 0x32706D66
+#define FBMP2_PREMULTIPLIED (1 << 0)
+#define FBMP2_RUN (1U << 31)
+
+typedef uint32_t pixel_t;
+
+typedef struct
+{
+    uint8_t* data;
+    uint64_t size;
+    uint64_t capacity;
+} buffer_t;
+
+static void buffer_push(buffer_t* buffer, const void* data, uint64_t size)
+{
+    if (buffer->size + size > buffer->capacity)
+    {
+        buffer->capacity = (buffer->size + size) * 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+        if (buffer->data == NULL)
+        {
+            fprintf(stderr, "fbmp2: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void buffer_push_u32(buffer_t* buffer, uint32_t value)
+{
+    buffer_push(buffer, &value, sizeof(uint32_t));
+}
+
+static pixel_t premultiply(pixel_t pixel)
+{
+    uint32_t a = pixel >> 24;
+    uint32_t r = (((pixel >> 16) & 0xFF) * a + 127) / 255;
+    uint32_t g = (((pixel >> 8) & 0xFF) * a + 127) / 255;
+    uint32_t b = ((pixel & 0xFF) * a + 127) / 255;
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+// Two or more equal pixels become a run, everything in between is gathered into literal packets. Packets may span several
+// rows of the tile, the tile is encoded as one sequence of pixels in row order.
+static void encode_tile(buffer_t* out, const pixel_t* pixels, uint64_t amount)
+{
+    uint64_t i = 0;
+    while (i < amount)
+    {
+        uint64_t run = 1;
+        while (i + run < amount && pixels[i + run] == pixels[i])
+        {
+            run++;
+        }
+
+        if (run >= 2)
+        {
+            buffer_push_u32(out, (uint32_t)run | FBMP2_RUN);
+            buffer_push(out, &pixels[i], sizeof(pixel_t));
+            i += run;
+            continue;
+        }
+
+        uint64_t literal = 1;
+        while (i + literal < amount && !(i + literal + 1 < amount && pixels[i + literal] == pixels[i + literal + 1]))
+        {
+            literal++;
+        }
+
+        buffer_push_u32(out, (uint32_t)literal);
+        buffer_push(out, &pixels[i], literal * sizeof(pixel_t));
+        i += literal;
+    }
+}
+
+static pixel_t* load(const char* path, uint32_t* width, uint32_t* height)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        perror(path);
+        return NULL;
+    }
+
+    uint32_t header[3];
+    if (fread(header, sizeof(uint32_t), 3, file) != 3 || header[0] != FBMP_MAGIC)
+    {
+        fprintf(stderr, "fbmp2: %s is not an uncompressed fbmp image\n", path);
+        fclose(file);
+        return NULL;
+    }
+    *width = header[1];
+    *height = header[2];
+
+    uint64_t amount = (uint64_t)*width * *height;
+    pixel_t* pixels = malloc(amount * sizeof(pixel_t));
+    if (pixels == NULL || fread(pixels, sizeof(pixel_t), amount, file) != amount)
+    {
+        fprintf(stderr, "fbmp2: %s is truncated\n", path);
+        free(pixels);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    return pixels;
+}
+
+int main(int argc, char** argv)
+{
+    bool premultiplied = false;
+    uint32_t tileSize = 32;
+
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        if (strcmp(argv[arg], "-p") == 0)
+        {
+            premultiplied = true;
+        }
+        else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc)
+        {
+            tileSize = (uint32_t)strtoul(argv[++arg], NULL, 10);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (argc - arg != 2 || tileSize == 0)
+    {
+        fprintf(stderr, "usage: %s [-p] [-t tileSize] input.fbmp output.fbmp\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint32_t width;
+    uint32_t height;
+    pixel_t* pixels = load(argv[arg], &width, &height);
+    if (pixels == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (premultiplied)
+    {
+        for (uint64_t i = 0; i < (uint64_t)width * height; i++)
+        {
+            pixels[i] = premultiply(pixels[i]);
+        }
+    }
+
+    uint32_t columns = (width + tileSize - 1) / tileSize;
+    uint32_t rows = (height + tileSize - 1) / tileSize;
+    uint32_t tileAmount = columns * rows;
+
+    buffer_t tiles = {0};
+    uint32_t* offsets = malloc((tileAmount + 1) * sizeof(uint32_t));
+    pixel_t* tile = malloc((uint64_t)tileSize * tileSize * sizeof(pixel_t));
+    if (offsets == NULL || tile == NULL)
+    {
+        fprintf(stderr, "fbmp2: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    uint64_t headerSize = 6 * sizeof(uint32_t) + (tileAmount + 1) * sizeof(uint32_t);
+    for (uint32_t row = 0; row < rows; row++)
+    {
+        for (uint32_t column = 0; column < columns; column++)
+        {
+            uint32_t tileWidth = width - column * tileSize < tileSize ? width - column * tileSize : tileSize;
+            uint32_t tileHeight = height - row * tileSize < tileSize ? height - row * tileSize : tileSize;
+            for (uint32_t y = 0; y < tileHeight; y++)
+            {
+                memcpy(&tile[y * tileWidth], &pixels[column * tileSize + (row * tileSize + y) * (uint64_t)width],
+                    tileWidth * sizeof(pixel_t));
+            }
+
+            offsets[column + row * columns] = (uint32_t)(headerSize + tiles.size);
+            encode_tile(&tiles, tile, (uint64_t)tileWidth * tileHeight);
+        }
+    }
+    offsets[tileAmount] = (uint32_t)(headerSize + tiles.size);
+
+    if (headerSize + tiles.size > UINT32_MAX)
+    {
+        fprintf(stderr, "fbmp2: image too large\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE* file = fopen(argv[arg + 1], "wb");
+    if (file == NULL)
+    {
+        perror(argv[arg + 1]);
+        return EXIT_FAILURE;
+    }
+
+    uint32_t header[6] = {FBMP2_MAGIC, width, height, premultiplied ? FBMP2_PREMULTIPLIED : 0, tileSize, tileAmount};
+    if (fwrite(header, sizeof(header), 1, file) != 1 ||
+        fwrite(offsets, sizeof(uint32_t), tileAmount + 1, file) != tileAmount + 1 ||
+        (tiles.size != 0 && fwrite(tiles.data, tiles.size, 1, file) != 1))
+    {
+        perror(argv[arg + 1]);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    fclose(file);
+    return EXIT_SUCCESS;
+}